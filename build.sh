@@ -99,6 +99,7 @@ Debug options:
     --gdb (or -g), debug the program in ‘gdb’
     --sanitize(or -S), build with Address Sanitizer
     --debug-std, use (slower) error-checking std data-structures for std classes like std::vector
+    --no-edge-pool, allocate follow-set hash tables with malloc/realloc rather than the size-classed pool allocator
 
 Testing options:
     --tests, run unit tests from ./src/tests/*.cpp
@@ -157,6 +158,10 @@ elif ! handle_flag "--faster-debug" ; then
     # These can be disabled with --faster-debug.
     export BUILD_FLAGS="$BUILD_FLAGS -D_GLIBCXX_DEBUG"
 fi
+# Use sparse hash's default allocator for the follow sets (see src/util/PoolAllocator.h).
+if handle_flag "--no-edge-pool" ; then
+    export BUILD_FLAGS="$BUILD_FLAGS -DNO_EDGE_SET_POOL"
+fi
 # Run address sanitizer. Substantial overhead. May require library support on some systems.
 if handle_flag "--sanitize" || handle_flag "-S" ; then
     export BUILD_SANITIZE=1
@@ -141,15 +141,14 @@ def hashkat_start_analysis_loop(state, callbacks):
     current_lib.hashkat_install_event_callbacks(state, callbacks)
     current_lib.hashkat_start_analysis_loop(state)
 
-# TODO: Properly serialize to remove need for re-adding ending
-def cstring_to_object(state, raw_string, ending = '}'):
-    string = ffi.string(raw_string).replace(': inf', ': "inf"').replace(': nan', ': "nan"') + ending
+def cstring_to_object(state, raw_string):
+    string = ffi.string(raw_string).replace(': inf', ': "inf"').replace(': nan', ': "nan"')
     current_lib.hashkat_dump_free(state, raw_string)
     return json.loads(string)
 
 def hashkat_dump_agents(state, dump_follow_sets=False):
     raw_string = current_lib.hashkat_dump_agents(state, dump_follow_sets)
-    return cstring_to_object(state, raw_string, ending = ']')
+    return cstring_to_object(state, raw_string)
 
 def hashkat_dump_state(state):
     raw_string = current_lib.hashkat_dump_state(state)
@@ -162,3 +161,10 @@ def hashkat_dump_summary(state):
 def hashkat_dump_stats(state):
     raw_string = current_lib.hashkat_dump_stats(state)
     return cstring_to_object(state, raw_string)
+
+# Write the dump straight to an open file, without holding it in memory:
+def hashkat_stream_summary(state, f):
+    f.flush()
+    sink = ffi.new('struct DumpSink[1]')
+    sink[0].fd = f.fileno()
+    return current_lib.hashkat_stream_summary(state, sink)
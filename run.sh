@@ -87,7 +87,8 @@ Configuration options:
     --input <FILE, default ./INFILE.yaml>, load network configuration options from the given input file (options for this file not discussed here).
 Misc options:
     Running ./scripts/stop.sh will send a SIGUSR1 (user-defined signal) to the binary ‘hashkat’, in effect resulting in graceful termination of the program. This can never result in immediate termination.
-    --no-ctrlc, do not handle Ctrl+C (note, results in immediate termination with Ctrl+C)"
+    --no-ctrlc, do not handle Ctrl+C (note, results in immediate termination with Ctrl+C)
+    --memory-report, print the memory held by each part of the simulation at exit"
     exit
 fi
 
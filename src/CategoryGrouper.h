@@ -27,8 +27,10 @@
 
 #include "util.h"
 #include "serialization.h"
+#include "util/FenwickTree.h"
 
 #include <vector>
+#include <algorithm>
 
 // Each category is defined with respect to a series of bounds
 // and a categorization variable. This categorization variable can
@@ -72,6 +74,13 @@ struct CategoryGrouper {
 	std::vector<Cat> categorizations;
 	std::vector<CategoryAgentList> categories;
 
+	// Fenwick tree over the category weights 'prob * agents.size()'. Kept up to date
+	// by add() and remove() once built; built lazily on the first weighted draw, and
+	// discarded whenever the probabilities change.
+	FenwickTree weight_tree;
+	// Updates since the last rebuild, to bound floating-point drift:
+	int n_weight_updates = 0;
+
 	// Incrementally update a categorization
 	void categorize(int agent, double parameter) {
 		if (categorizations.size() <= agent) {
@@ -79,18 +88,48 @@ struct CategoryGrouper {
 			categorizations.resize(agent + 1);
 		}
 		Cat& c = categorizations.at(agent);
-		for (int i = 0; i < categories.size(); i++) {
-			CategoryAgentList& C = categories[i];
-			if (parameter <= C.threshold) {
-				if (i != c.category) {
-					// We have to move ourselves into the new list
-					remove(c);
-					c = add(agent, i);
-				}
-				return; // Categorized, done.
+		// Parameters typically move by one, so check our category and its neighbours first:
+		int i = c.category;
+		if (i != -1 && !fits(i, parameter)) {
+			if (i + 1 < categories.size() && fits(i + 1, parameter)) {
+				i = i + 1;
+			} else if (i > 0 && fits(i - 1, parameter)) {
+				i = i - 1;
+			} else {
+				i = find_category(parameter);
+			}
+		} else if (i == -1) {
+			i = find_category(parameter);
+		}
+		if (i == -1) {
+			DEBUG_CHECK(false, "Logic error");
+			return;
+		}
+		if (i != c.category) {
+			// We have to move ourselves into the new list
+			remove(c);
+			c = add(agent, i);
+		}
+	}
+
+	// Whether 'parameter' falls in category 'i', ie, above the previous threshold and at most this one.
+	bool fits(int i, double parameter) const {
+		return parameter <= categories[i].threshold && (i == 0 || parameter > categories[i - 1].threshold);
+	}
+
+	// The first category whose threshold is at least 'parameter', by binary search
+	// (thresholds are ascending). Returns -1 if there is none.
+	int find_category(double parameter) const {
+		int lo = 0, hi = categories.size();
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (categories[mid].threshold < parameter) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
 			}
 		}
-		DEBUG_CHECK(false, "Logic error");
+		return (lo < categories.size()) ? lo : -1;
 	}
 
 	/* Remove a categorized agent. */
@@ -103,6 +142,7 @@ struct CategoryGrouper {
 			c_top.index = c.index;
 			C.agents[c.index] = C.agents.back();
 			C.agents.pop_back();
+			update_weight(c.category, -C.prob);
 			// Reset:
 			c = Cat();
 		}
@@ -116,17 +156,85 @@ struct CategoryGrouper {
             categories[i].prob = C.categories[i].prob;
             categories[i].threshold = C.categories[i].threshold;
         }
+        weight_tree.clear();
+	}
+
+	double category_weight(int i) const {
+		return categories[i].prob * categories[i].agents.size();
+	}
+
+	double total_weight() {
+		ensure_weight_tree();
+		return weight_tree.total();
+	}
+
+	/* Pick a category with probability proportional to its weight, in O(log n).
+	 * 'rand_num' is uniform in (0, 1]. Returns -1 if all categories have zero weight. */
+	int pick_weighted(double rand_num) {
+		double total = total_weight();
+		if (total <= 0) {
+			return -1;
+		}
+		int pos = weight_tree.find(rand_num * total);
+		// Rounding may land on an empty category, take the nearest one with weight instead:
+		int n = categories.size();
+		for (int dist = 0; dist < n; dist++) {
+			if (pos - dist >= 0 && category_weight(pos - dist) > 0) {
+				return pos - dist;
+			}
+			if (pos + dist < n && category_weight(pos + dist) > 0) {
+				return pos + dist;
+			}
+		}
+		return -1; // Only drift was left in the tree
+	}
+
+	// Approximate bytes held, including the grouper object itself.
+	size_t memory_usage() const {
+		size_t usage = sizeof(*this) + categorizations.capacity() * sizeof(Cat)
+				+ categories.capacity() * sizeof(CategoryAgentList)
+				+ weight_tree.memory_usage() - sizeof(weight_tree);
+		for (auto& C : categories) {
+			usage += C.agents.capacity() * sizeof(int);
+		}
+		return usage;
 	}
 
 	Cat add(int agent, int new_cat) {
 		CategoryAgentList& C = categories.at(new_cat);
 		C.agents.push_back(agent);
+		update_weight(new_cat, C.prob);
 		return Cat(new_cat, C.agents.size() - 1);
 	}
 
 	template <typename Archive>
     void serialize(Archive& ar) {
 	    ar(categorizations, categories);
+	    // Rebuilt on demand:
+	    weight_tree.clear();
+	}
+
+private:
+	static const int WEIGHT_REBUILD_PERIOD = 1 << 16;
+
+	void ensure_weight_tree() {
+		if (weight_tree.size() == categories.size() && n_weight_updates < WEIGHT_REBUILD_PERIOD) {
+			return;
+		}
+		std::vector<double> weights(categories.size());
+		for (int i = 0; i < categories.size(); i++) {
+			weights[i] = category_weight(i);
+		}
+		weight_tree.assign(weights);
+		n_weight_updates = 0;
+	}
+
+	void update_weight(int category, double delta) {
+		if (weight_tree.size() != categories.size()) {
+			return; // Not built yet
+		}
+		weight_tree.add(category, delta);
+		n_weight_updates++;
 	}
 };
 
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors.
+ */
+
+#ifndef CHECKPOINTLOG_H_
+#define CHECKPOINTLOG_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "dependencies/lcommon/Timer.h"
+
+// The changes made to the network since the last checkpoint (see analyzer_snapshot.cpp).
+// Once a run has written its base snapshot, every change to an agent record marks the
+// agent dirty, and every follow or unfollow is logged, so that the next checkpoint only
+// has to write those. Inactive (and free of cost beyond a branch) otherwise.
+struct CheckpointLog {
+    enum EdgeOp {
+        UNFOLLOW = 0,
+        FOLLOW = 1
+    };
+    struct EdgeChange {
+        int follower, followed, op;
+    };
+
+    bool enabled = false;
+    // Identifies the base snapshot the deltas apply to:
+    uint64_t base_id = 0;
+    int n_deltas = 0;
+
+    // In the order they happened:
+    std::vector<EdgeChange> edge_changes;
+    // In the order they were first marked:
+    std::vector<int> dirty_agents;
+    // Hashes of the state sections as last written, by AnalysisState::StatePart;
+    // deltas leave out the sections that still hash the same. Empty when unknown, so all are written.
+    std::vector<size_t> state_fingerprints;
+
+    // A checkpoint being written by a forked child (output.checkpoint_fork).
+    struct BackgroundWrite {
+        int pid;
+        std::string file;
+        bool is_base;
+        Timer timer;
+        // The child sends its state_fingerprints back through this pipe:
+        int fingerprints_fd;
+        int fork_number;
+    };
+    // Oldest first:
+    std::vector<BackgroundWrite> background;
+    int n_forks = 0;
+
+    // Start a new chain of deltas on top of base snapshot 'id'.
+    void start(uint64_t id) {
+        enabled = true;
+        base_id = id;
+        n_deltas = 0;
+        clear();
+    }
+
+    // Forget the changes, once they are written.
+    void clear() {
+        for (int id : dirty_agents) {
+            is_dirty[id] = false;
+        }
+        dirty_agents.clear();
+        edge_changes.clear();
+    }
+
+    void mark_agent(int id) {
+        if (!enabled) {
+            return;
+        }
+        if (id >= is_dirty.size()) {
+            is_dirty.resize(id + 1, false);
+        }
+        if (!is_dirty[id]) {
+            is_dirty[id] = true;
+            dirty_agents.push_back(id);
+        }
+    }
+
+    // Both agents are marked as well, for their follow method counts and chatiness.
+    void log_edge(int follower, int followed, EdgeOp op) {
+        if (!enabled) {
+            return;
+        }
+        edge_changes.push_back({follower, followed, op});
+        mark_agent(follower);
+        mark_agent(followed);
+    }
+
+    // Approximate bytes held, including the log object itself.
+    size_t memory_usage() const {
+        return sizeof(*this) + edge_changes.capacity() * sizeof(EdgeChange)
+                + dirty_agents.capacity() * sizeof(int) + is_dirty.capacity() / 8
+                + state_fingerprints.capacity() * sizeof(size_t);
+    }
+
+private:
+    std::vector<bool> is_dirty;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors.
+ */
+
+#ifndef DEGREEHISTOGRAMS_H_
+#define DEGREEHISTOGRAMS_H_
+
+#include <vector>
+
+#include "network.h"
+
+// The number of agents at each out-, in- and total degree, over all agents and per agent type.
+// Kept up to date on every follow, unfollow and new agent while 'degree_distributions' is on, so
+// that the monthly degree distributions do not need a pass over the network. Built from the
+// network once its initial agents are in (or it was loaded), and inactive before then.
+struct DegreeHistograms {
+    struct Histograms {
+        std::vector<int> out_degrees, in_degrees, total_degrees;
+    };
+
+    bool enabled = false;
+    Histograms all;
+    std::vector<Histograms> types;
+
+    // Count every agent of 'network' from scratch.
+    void build(Network& network, int n_types) {
+        enabled = true;
+        all = Histograms();
+        types.assign(n_types, Histograms());
+        for (int id = 0; id < network.size(); id++) {
+            Agent& e = network[id];
+            add(e.agent_type, e.following_set().size(), e.follower_set().size(), +1);
+        }
+    }
+
+    // A new agent, with no follows yet.
+    void add_agent(const Agent& e) {
+        add(e.agent_type, 0, 0, +1);
+    }
+
+    // 'e' has gained (or lost, if negative) 'd_out' followings and 'd_in' followers,
+    // and its sets already reflect it.
+    void changed(Agent& e, int d_out, int d_in) {
+        int out_degree = e.following_set().size(), in_degree = e.follower_set().size();
+        add(e.agent_type, out_degree - d_out, in_degree - d_in, -1);
+        add(e.agent_type, out_degree, in_degree, +1);
+    }
+
+    // The number of agents counted, for consistency checks.
+    int n_agents() const {
+        int n = 0;
+        for (int count : all.out_degrees) {
+            n += count;
+        }
+        return n;
+    }
+
+private:
+    void add(int agent_type, int out_degree, int in_degree, int n) {
+        add(all, out_degree, in_degree, n);
+        add(types[agent_type], out_degree, in_degree, n);
+    }
+
+    static void add(Histograms& histograms, int out_degree, int in_degree, int n) {
+        add(histograms.out_degrees, out_degree, n);
+        add(histograms.in_degrees, in_degree, n);
+        add(histograms.total_degrees, out_degree + in_degree, n);
+    }
+
+    static void add(std::vector<int>& histogram, int degree, int n) {
+        if (degree >= histogram.size()) {
+            histogram.resize(degree + 1, 0);
+        }
+        histogram[degree] += n;
+    }
+};
+
+#endif
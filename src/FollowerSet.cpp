@@ -23,6 +23,8 @@
  */
 
 #include <cmath>
+#include <new>
+#include <algorithm>
 
 #include "FollowerSet.h"
 
@@ -36,23 +38,120 @@ using namespace std;
 
 /*****************************************************************************
  * Layer implementations:
+ * A layer splits its followers into N sublayers by one agent attribute, its
+ * dimension. The leaf of the layer stack is a plain HashedEdgeSet.
  *****************************************************************************/
 
-typedef IdeologyLayer LeafLayer;
-int IdeologyLayer::classify(Agent& agent) {
-    return agent.ideology_bin;
-}
+// Passed down the layers while determining tweet weights:
+struct WeightContext {
+    Agent& author;
+    TweetContent& content;
+    FollowerSet::WeightDeterminer& determiner;
+    int ideology; // Ideology bin of the leaf being weighed
+};
+
+// Each dimension classifies agents, or their leaf keys (see FollowerSet::leaf_key),
+// and may restrict which bins react to a tweet.
+struct LanguageDim {
+    static int classify(Agent& agent) {
+        return agent.language;
+    }
+    static int classify_key(int leaf_key) {
+        return leaf_key / (N_BIN_PREFERENCE_CLASS * N_BIN_REGIONS * N_BIN_IDEOLOGIES);
+    }
+    static bool enter(WeightContext& context, int bin) {
+        // A hard all-or-nothing cutoff for tweet reaction:
+        return language_understandable((Language)bin, context.content.language);
+    }
+};
 
-int PreferenceClassLayer::classify(Agent& agent) {
-    return agent.preference_class;
-}
+struct PreferenceClassDim {
+    static int classify(Agent& agent) {
+        return agent.preference_class;
+    }
+    static int classify_key(int leaf_key) {
+        return leaf_key / (N_BIN_REGIONS * N_BIN_IDEOLOGIES) % N_BIN_PREFERENCE_CLASS;
+    }
+    static bool enter(WeightContext& context, int bin) {
+        return true;
+    }
+};
+
+struct RegionDim {
+    static int classify(Agent& agent) {
+        return agent.region_bin;
+    }
+    static int classify_key(int leaf_key) {
+        return leaf_key / N_BIN_IDEOLOGIES % N_BIN_REGIONS;
+    }
+    static bool enter(WeightContext& context, int bin) {
+        return true;
+    }
+};
+
+struct IdeologyDim {
+    static int classify(Agent& agent) {
+        return agent.ideology_bin;
+    }
+    static int classify_key(int leaf_key) {
+        return leaf_key % N_BIN_IDEOLOGIES;
+    }
+    static bool enter(WeightContext& context, int bin) {
+        context.ideology = bin;
+        return true;
+    }
+};
+
+typedef HashedEdgeSet<int> LeafSet;
+
+struct LeafWeights {
+    double total_weight = 0;
+    int n_excluded = 0; // Followers that can no longer react, see exclude_tweet_weight
+};
 
-int RegionLayer::classify(Agent& agent) {
-    return agent.region_bin;
+template <typename Layer>
+struct WeightsOf {
+    typedef typename Layer::Weights type;
+};
+
+template <>
+struct WeightsOf<LeafSet> {
+    typedef LeafWeights type;
+};
+
+template <typename Dim, int N, typename Child>
+struct Layer {
+    typedef Child ChildLayer;
+    typedef typename WeightsOf<Child>::type ChildWeights;
+    static const int N_SUBLAYERS = N;
+
+    struct Weights {
+        ChildWeights subweights[N];
+        double total_weight = 0;
+    };
+
+    int n_elems = 0; // Total
+    Child sublayers[N];
+};
+
+// A dimension with a single bin is elided, leaving only its child layer:
+template <typename Dim, int N, typename Child>
+struct MakeLayer {
+    typedef Layer<Dim, N, Child> type;
+};
+
+template <typename Dim, typename Child>
+struct MakeLayer<Dim, 1, Child> {
+    typedef Child type;
+};
+
+static int layer_size(const LeafSet& set) {
+    return set.size();
 }
 
-int LanguageLayer::classify(Agent& agent) {
-    return agent.language;
+template <typename Dim, int N, typename Child>
+static int layer_size(const Layer<Dim, N, Child>& layer) {
+    return layer.n_elems;
 }
 
 /*****************************************************************************
@@ -62,37 +161,76 @@ int LanguageLayer::classify(Agent& agent) {
  *
  *****************************************************************************/
 
-// Provides additional debug checking:
-template <typename Layer>
-static int classify(Layer& layer, Agent& agent) {
-    int bin = layer.classify(agent);
-    DEBUG_CHECK(bin >= 0 && bin < Layer::N_SUBLAYERS, "Logic error!");
+// Layers are sized to the configured bins, so an out-of-range bin would write out of bounds:
+template <typename Dim, int N>
+static int classify(Agent& agent) {
+    int bin = Dim::classify(agent);
+    ASSERT(bin >= 0 && bin < N, "Agent bin outside of the follower set layer!");
     return bin;
 }
 
 // Leaf layer specialization
-static bool add_follower(LeafLayer& layer, Agent& agent) {
-    auto& sub = layer.sublayers[classify(layer, agent)];
-    if (sub.insert(agent.id)) {
+static bool add_follower(LeafSet& set, Agent& agent) {
+    return set.insert(agent.id);
+}
+
+// Parent layers template
+template <typename Dim, int N, typename Child>
+static bool add_follower(Layer<Dim, N, Child>& layer, Agent& agent) {
+    auto& sub = layer.sublayers[classify<Dim, N>(agent)];
+    if (add_follower(sub, agent)) {
         layer.n_elems++;
         return true;
     }
     return false;
 }
 
-// Parent layers template
-template <typename Layer>
-static bool add_follower(Layer& layer, Agent& agent) {
-    auto& sub = layer.sublayers[classify(layer, agent)];
-     if (add_follower(sub, agent)) {
-         layer.n_elems++;
-         return true;
-     }
-     return false;
+/*****************************************************************************
+ * add_all implementation:
+ * Each parent layer sorts its batch into its bins, keeping the order within a
+ * bin, so that each leaf inserts its whole batch into a table sized for it.
+ *****************************************************************************/
+
+// Leaf layer specialization
+static size_t add_followers(LeafSet& set, Agent** agents, size_t n) {
+    set.reserve(set.size() + n);
+    size_t n_added = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (set.insert(agents[i]->id)) {
+            n_added++;
+        } else {
+            agents[i] = NULL; // Already a follower
+        }
+    }
+    return n_added;
 }
 
-bool FollowerSet::add(Agent& agent) {
-    return add_follower(followers, agent);
+// Parent layers template
+template <typename Dim, int N, typename Child>
+static size_t add_followers(Layer<Dim, N, Child>& layer, Agent** agents, size_t n) {
+    size_t starts[N + 1] = {0};
+    for (size_t i = 0; i < n; i++) {
+        starts[classify<Dim, N>(*agents[i]) + 1]++;
+    }
+    for (int bin = 0; bin < N; bin++) {
+        starts[bin + 1] += starts[bin];
+    }
+    std::vector<Agent*> sorted(n);
+    size_t fill[N];
+    std::copy(starts, starts + N, fill);
+    for (size_t i = 0; i < n; i++) {
+        sorted[fill[classify<Dim, N>(*agents[i])]++] = agents[i];
+    }
+    std::copy(sorted.begin(), sorted.end(), agents);
+
+    size_t n_added = 0;
+    for (int bin = 0; bin < N; bin++) {
+        if (starts[bin + 1] > starts[bin]) {
+            n_added += add_followers(layer.sublayers[bin], agents + starts[bin], starts[bin + 1] - starts[bin]);
+        }
+    }
+    layer.n_elems += n_added;
+    return n_added;
 }
 
 /*****************************************************************************
@@ -102,19 +240,14 @@ bool FollowerSet::add(Agent& agent) {
  *****************************************************************************/
 
 // Leaf layer specialization
-static bool remove_follower(LeafLayer& layer, Agent& agent) {
-    auto& sub = layer.sublayers[layer.classify(agent)];
-    if (sub.erase(agent.id)) {
-        layer.n_elems--;
-        return true;
-    }
-    return false;
+static bool remove_follower(LeafSet& set, Agent& agent) {
+    return set.erase(agent.id);
 }
 
 // Parent layers template
-template <typename Layer>
-static bool remove_follower(Layer& layer, Agent& agent) {
-    auto& sub = layer.sublayers[layer.classify(agent)];
+template <typename Dim, int N, typename Child>
+static bool remove_follower(Layer<Dim, N, Child>& layer, Agent& agent) {
+    auto& sub = layer.sublayers[classify<Dim, N>(agent)];
     if (remove_follower(sub, agent)) {
         layer.n_elems--;
         return true;
@@ -122,40 +255,73 @@ static bool remove_follower(Layer& layer, Agent& agent) {
     return false;
 }
 
-bool FollowerSet::remove(Agent& agent) {
-    return remove_follower(followers, agent);
+/*****************************************************************************
+ * for_each implementation:
+ *****************************************************************************/
+
+// Leaf layer specialization
+static void for_each_follower(LeafSet& set, const std::function<void(int)>& func) {
+    LeafSet::iterator iter;
+    while (set.iterate(iter)) {
+        func(iter.get());
+    }
+}
+
+// Parent layers template
+template <typename Dim, int N, typename Child>
+static void for_each_follower(Layer<Dim, N, Child>& layer, const std::function<void(int)>& func) {
+    for (auto& sublayer : layer.sublayers) {
+        if (layer_size(sublayer) > 0) {
+            for_each_follower(sublayer, func);
+        }
+    }
 }
 
 /*****************************************************************************
  * pick_random_weighted implementation:
  *****************************************************************************/
 
+typedef std::function<bool(int)> ExcludedCheck;
+
 // Leaf layer specialization
-static bool pick_weighted(MTwist& rng, LeafLayer& layer, LeafLayer::Weights& weights, int& id) {
-    int bin = rng.kmc_select(weights.weights, LeafLayer::N_SUBLAYERS, weights.total_weight);
-    bool picked_valid = layer.sublayers[bin].pick_random_uniform(rng, id);
-    bool had_non0 = false;
-    for (double w : weights.weights) {
-        if (w != 0) had_non0 = true;
+static bool pick_weighted(MTwist& rng, LeafSet& set, LeafWeights& weights, int& id, const ExcludedCheck& is_excluded) {
+    // Rejection sampling is cheap while most of the set can react:
+    const int MAX_REJECTIONS = 16;
+    if (weights.n_excluded * 2 <= (int)set.size()) {
+        for (int i = 0; i < MAX_REJECTIONS; i++) {
+            bool picked_valid = set.pick_random_uniform(rng, id);
+            ASSERT(picked_valid || weights.total_weight == 0, "If weight was not 0, should not pick empty!");
+            if (!picked_valid || !is_excluded(id)) {
+                return picked_valid;
+            }
+        }
+    }
+    // Otherwise pick among the followers that can react directly:
+    std::vector<int> eligible;
+    for_each_follower(set, [&](int id_follower) {
+        if (!is_excluded(id_follower)) {
+            eligible.push_back(id_follower);
+        }
+    });
+    if (eligible.empty()) {
+        return false;
     }
-    ASSERT(!(!picked_valid && had_non0), "If weight was not 0, should not pick empty!");
-    return picked_valid;
+    id = eligible[rng.rand_int(eligible.size())];
+    return true;
 }
 
 // Parent layers template
-template <typename Layer>
-static bool pick_weighted(MTwist& rng, Layer& layer, typename Layer::Weights& weights, int& id_result) {
-    auto* subweight = rng.general_kmc_select(weights.subweights, Layer::N_SUBLAYERS, weights.total_weight,
-        [](typename Layer::ChildLayer::Weights& subweights) {
+template <typename Dim, int N, typename Child>
+static bool pick_weighted(MTwist& rng, Layer<Dim, N, Child>& layer, typename Layer<Dim, N, Child>::Weights& weights, int& id_result,
+        const ExcludedCheck& is_excluded) {
+    typedef typename Layer<Dim, N, Child>::ChildWeights ChildWeights;
+    auto* subweight = rng.general_kmc_select(weights.subweights, N, weights.total_weight,
+        [](ChildWeights& subweights) {
             return subweights.total_weight;
     });
     ASSERT(subweight->total_weight > 0, "Picked a 0 weight bin!");
     int layer_index = (subweight - weights.subweights);
-    return pick_weighted(rng, layer.sublayers[layer_index], *subweight, id_result);
-}
-
-bool FollowerSet::pick_random_weighted(MTwist rng, Weights& weights, int& id) {
-    return pick_weighted(rng, followers, weights, id);
+    return pick_weighted(rng, layer.sublayers[layer_index], *subweight, id_result, is_excluded);
 }
 
 /*****************************************************************************
@@ -163,23 +329,16 @@ bool FollowerSet::pick_random_weighted(MTwist rng, Weights& weights, int& id) {
  *****************************************************************************/
 
 // Leaf layer specialization
-static bool pick_uniform(MTwist& rng, LeafLayer& layer, int& id) {
-    int R = rng.rand_int(layer.n_elems);
-    for (auto& sublayer : layer.sublayers) {
-        R -= sublayer.size();
-        if (R < 0) {
-            return sublayer.pick_random_uniform(rng, id);
-        }
-    }
-    return false;
+static bool pick_uniform(MTwist& rng, LeafSet& set, int& id) {
+    return set.pick_random_uniform(rng, id);
 }
 
 // Parent layers template
-template <typename Layer>
-static bool pick_uniform(MTwist& rng, Layer& layer, int& id) {
+template <typename Dim, int N, typename Child>
+static bool pick_uniform(MTwist& rng, Layer<Dim, N, Child>& layer, int& id) {
     int R = rng.rand_int(layer.n_elems);
     for (auto& sublayer : layer.sublayers) {
-        R -= sublayer.n_elems;
+        R -= layer_size(sublayer);
         if (R < 0) {
             return pick_uniform(rng, sublayer, id);
         }
@@ -187,8 +346,28 @@ static bool pick_uniform(MTwist& rng, Layer& layer, int& id) {
     return false;
 }
 
-bool FollowerSet::pick_random_uniform(MTwist& rng, int& id) {
-    return pick_uniform(rng, followers, id);
+/*****************************************************************************
+ * memory_usage implementation:
+ * Sub-layers are embedded in their parents, so each layer only adds the
+ * heap storage of the hash sets below it.
+ *****************************************************************************/
+
+// Leaf layer specialization
+static size_t layer_heap_usage(const LeafSet& set) {
+    return set.memory_usage() - sizeof(set);
+}
+
+// Parent layers template
+template <typename Dim, int N, typename Child>
+static size_t layer_heap_usage(const Layer<Dim, N, Child>& layer) {
+    // Most sub-layers of a follower set are empty, measure an empty one only once.
+    // (An emptied sub-layer may hold somewhat more than a fresh one, this is ignored.)
+    static const size_t empty_usage = layer_heap_usage(Child());
+    size_t usage = 0;
+    for (auto& sublayer : layer.sublayers) {
+        usage += (layer_size(sublayer) == 0) ? empty_usage : layer_heap_usage(sublayer);
+    }
+    return usage;
 }
 
 /*****************************************************************************
@@ -196,80 +375,42 @@ bool FollowerSet::pick_random_uniform(MTwist& rng, int& id) {
  *****************************************************************************/
 
 // Leaf layer specialization
-static void print_layer(LeafLayer& layer, int depth) {
-    for (int i = 0; i < LeafLayer::N_SUBLAYERS; i++) {
-        string repr = format("%s (Bin %d)", cpp_type_name(layer).c_str(), i);
-        auto& sublayer = layer.sublayers[i];
-        if (sublayer.size() > 0) {
-            for (int i = 0; i < depth; i++) {
-                printf("  ");
-            }
-            printf("[%s] (N_elems %d)\n", repr.c_str(), (int) sublayer.size());
-            for (int i = 0; i < depth + 1; i++) {
-                printf("  ");
-            }
-            sublayer.print();
-        }
+static void print_layer(LeafSet& set, int depth) {
+    for (int i = 0; i < depth; i++) {
+        printf("  ");
     }
+    set.print();
 }
 
 // Parent layers template
-template <typename Layer>
-static void print_layer(Layer& layer, int depth) {
-    for (int i = 0; i < Layer::N_SUBLAYERS; i++) {
-        string repr = format("%s (Bin %d)", cpp_type_name(layer).c_str(), i);
+template <typename Dim, int N, typename Child>
+static void print_layer(Layer<Dim, N, Child>& layer, int depth) {
+    for (int i = 0; i < N; i++) {
+        string repr = format("%s (Bin %d)", cpp_type_name(Dim()).c_str(), i);
         auto& sublayer = layer.sublayers[i];
-        if (sublayer.n_elems > 0) {
+        if (layer_size(sublayer) > 0) {
             for (int i = 0; i < depth; i++) {
                 printf("  ");
             }
-            printf("[%s] (N_elems %d)\n", repr.c_str(), sublayer.n_elems);
+            printf("[%s] (N_elems %d)\n", repr.c_str(), layer_size(sublayer));
             print_layer(sublayer, depth + 1);
         }
     }
 }
 
-void FollowerSet::print() {
-    print_layer(followers, 0);
-}
-
-void FollowerSet::post_load(AnalysisState& state) {
-    ASSERT(serialization_cache != NULL, "No serialization cache (from serialize)!");
-    for (int agent_id : *serialization_cache) {
-        add(state.network[agent_id]);
-    }
-    delete serialization_cache;
-    serialization_cache = NULL;
-}
-
-
-// Reproduces github issue 109.
-// Does the total weight for a subtree of the retweet rates check out?
-// Leaf layer specialization
-static void assert_weight_integrity(LeafLayer& layer, LeafLayer::Weights& weights) {
-    double total_weight = 0;
-    for (double weight : weights.weights) {
-        total_weight += weight;
-    }
-    if (total_weight > 0) {
-        ASSERT(layer.n_elems > 0, "Should not have weight where we do not have elements!");
-    }
-    ASSERT(fabs(weights.total_weight - total_weight) <= ZEROTOL, "Weight integrity failed!");
-}
+/*****************************************************************************
+ * determine_tweet_weights implementation:
+ *****************************************************************************/
 
 // Reproduces github issue 109.
 // Does the total weight for a subtree of the retweet rates check out?
-// Parent layer
 template <typename Layer, typename Weights>
 static void assert_weight_integrity(Layer& layer, Weights& weights) {
     // These checks are somewhat expensive, only enable in debug mode:
 #ifndef NDEBUG
     double total_weight = 0;
-    int i = 0;
     for (auto& subweight : weights.subweights) {
-        assert_weight_integrity(layer.sublayers[i], subweight);
         total_weight += subweight.total_weight;
-        i++;
     }
     ASSERT(fabs(weights.total_weight - total_weight) <= ZEROTOL, "Weight integrity failed!");
     if (total_weight > 0) {
@@ -278,66 +419,398 @@ static void assert_weight_integrity(Layer& layer, Weights& weights) {
 #endif
 }
 
-double FollowerSet::determine_tweet_weights(Agent& author, TweetContent& content, WeightDeterminer& d_root, /*Weights placed here:*/ Weights& w_root) {
-    PERF_TIMER();
-    // Weights are assumed to start 0-initialized.
+// The weight of each follower in the leaf being weighed:
+static double leaf_weight(WeightContext& context) {
+    TweetType type = context.content.type;
+    if (type == TWEET_IDEOLOGICAL && context.ideology == context.content.ideology_bin) {
+        type = TWEET_IDEOLOGICAL_DIFFERENT;
+    }
+    return context.determiner.weights[context.ideology][type][context.author.agent_type];
+}
 
-    auto& f_root = followers;
+// Leaf layer specialization
+static double determine_weights(WeightContext& context, LeafSet& set, LeafWeights& weights) {
+    return (weights.total_weight = leaf_weight(context) * set.size());
+}
 
-    DEBUG_CHECK(content.language != LANG_FRENCH_AND_ENGLISH, "Invalid tweet language!");
+// Parent layers template
+// Weights are assumed to start 0-initialized; empty sublayers are left at 0.
+template <typename Dim, int N, typename Child>
+static double determine_weights(WeightContext& context, Layer<Dim, N, Child>& layer, typename Layer<Dim, N, Child>::Weights& weights) {
+    double weight_sum = 0;
+    for (int i = 0; i < N; i++) {
+        auto& sublayer = layer.sublayers[i];
+        if (layer_size(sublayer) > 0 && Dim::enter(context, i)) {
+            weight_sum += determine_weights(context, sublayer, weights.subweights[i]);
+        }
+    }
+    weights.total_weight = weight_sum;
+    assert_weight_integrity(layer, weights);
+    return weight_sum;
+}
+
+/*****************************************************************************
+ * exclude_tweet_weight implementation:
+ * Only the path down to the leaf of the excluded followers changes. Sums are
+ * taken afresh, rather than decremented, so that a fully excluded subtree has
+ * exactly zero weight.
+ *****************************************************************************/
+
+template <typename Dim, int N>
+static int classify_key(int leaf_key) {
+    int bin = Dim::classify_key(leaf_key);
+    ASSERT(bin >= 0 && bin < N, "Leaf key bin outside of the follower set layer!");
+    return bin;
+}
 
-    if (followers.n_elems == 0) {
+// Leaf layer specialization
+static double exclude_weight(WeightContext& context, LeafSet& set, LeafWeights& weights, int leaf_key, int count) {
+    weights.n_excluded += count;
+    weights.total_weight = leaf_weight(context) * std::max(0, (int)set.size() - weights.n_excluded);
+    return weights.total_weight;
+}
+
+// Parent layers template
+template <typename Dim, int N, typename Child>
+static double exclude_weight(WeightContext& context, Layer<Dim, N, Child>& layer, typename Layer<Dim, N, Child>::Weights& weights,
+        int leaf_key, int count) {
+    int bin = classify_key<Dim, N>(leaf_key);
+    if (layer_size(layer.sublayers[bin]) == 0 || !Dim::enter(context, bin)) {
+        return weights.total_weight; // Not weighed to begin with
+    }
+    exclude_weight(context, layer.sublayers[bin], weights.subweights[bin], leaf_key, count);
+    double weight_sum = 0;
+    for (auto& subweight : weights.subweights) {
+        weight_sum += subweight.total_weight;
+    }
+    return (weights.total_weight = weight_sum);
+}
+
+/*****************************************************************************
+ * Layer stacks, specialized for the number of bins in each dimension:
+ *****************************************************************************/
+
+template <int N_LANG, int N_PREF, int N_REGION, int N_IDEO>
+struct FollowerLayerStack : FollowerLayers {
+    typedef typename MakeLayer<IdeologyDim, N_IDEO, LeafSet>::type IdeologyLayers;
+    typedef typename MakeLayer<RegionDim, N_REGION, IdeologyLayers>::type RegionLayers;
+    typedef typename MakeLayer<PreferenceClassDim, N_PREF, RegionLayers>::type PreferenceClassLayers;
+    typedef typename MakeLayer<LanguageDim, N_LANG, PreferenceClassLayers>::type TopLayer;
+    typedef typename WeightsOf<TopLayer>::type Weights;
+    static_assert(sizeof(Weights) <= sizeof(FollowerSet::Weights), "FollowerSet::Weights is too small!");
+
+    TopLayer top;
+
+    // Elided dimensions are not classified, their only bin is 0:
+    static bool fits(Agent& agent) {
+        return within_range((int)agent.language, 0, N_LANG) && within_range(agent.preference_class, 0, N_PREF)
+                && within_range(agent.region_bin, 0, N_REGION) && within_range(agent.ideology_bin, 0, N_IDEO);
+    }
+
+    virtual bool add(Agent& agent) {
+        ASSERT(fits(agent), "Agent does not fit the follower set dimensions!");
+        return add_follower(top, agent);
+    }
+    virtual size_t add_all(Agent** agents, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            ASSERT(fits(*agents[i]), "Agent does not fit the follower set dimensions!");
+        }
+        return add_followers(top, agents, n);
+    }
+    virtual bool remove(Agent& agent) {
+        ASSERT(fits(agent), "Agent does not fit the follower set dimensions!");
+        return remove_follower(top, agent);
+    }
+    virtual bool pick_weighted(MTwist& rng, FollowerSet::Weights& weights, int& id, const ExcludedCheck& is_excluded) {
+        return ::pick_weighted(rng, top, *(Weights*)weights.storage, id, is_excluded);
+    }
+    virtual bool pick_uniform(MTwist& rng, int& id) {
+        return ::pick_uniform(rng, top, id);
+    }
+    virtual void for_each(const std::function<void(int)>& func) {
+        for_each_follower(top, func);
+    }
+    virtual double determine_tweet_weights(Agent& author, TweetContent& content,
+            FollowerSet::WeightDeterminer& determiner, FollowerSet::Weights& output) {
+        Weights& weights = *new (output.storage) Weights();
+        WeightContext context = {author, content, determiner, 0};
+        if (N_LANG == 1 && !LanguageDim::enter(context, 0)) {
+            return 0;
+        }
+        return determine_weights(context, top, weights);
+    }
+    virtual double exclude_tweet_weight(int leaf_key, int count, Agent& author, TweetContent& content,
+            FollowerSet::WeightDeterminer& determiner, FollowerSet::Weights& output) {
+        Weights& weights = *(Weights*)output.storage;
+        WeightContext context = {author, content, determiner, 0};
+        if (N_LANG == 1 && !LanguageDim::enter(context, 0)) {
+            return 0;
+        }
+        return exclude_weight(context, top, weights, leaf_key, count);
+    }
+    virtual size_t memory_usage() const {
+        return sizeof(*this) + layer_heap_usage(top);
+    }
+    virtual void print() {
+        print_layer(top, 0);
+    }
+};
+
+template <int N_LANG, int N_PREF, int N_REGION, int N_IDEO>
+static FollowerLayers* create_layers() {
+    return new FollowerLayerStack<N_LANG, N_PREF, N_REGION, N_IDEO>();
+}
+
+// Runtime dispatch to the stack for the configured dimensions. Each Select template
+// matches one dimension against the candidate size N, counting down from the
+// compile-time bound, then moves on to the next dimension. Returns NULL if out of bounds.
+template <int N_LANG, int N_PREF, int N_REGION, int N = N_BIN_IDEOLOGIES>
+struct SelectIdeologies {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        if (dims.n_ideologies == N) {
+            return create_layers<N_LANG, N_PREF, N_REGION, N>;
+        }
+        return SelectIdeologies<N_LANG, N_PREF, N_REGION, N - 1>::select(dims);
+    }
+};
+
+template <int N_LANG, int N_PREF, int N_REGION>
+struct SelectIdeologies<N_LANG, N_PREF, N_REGION, 0> {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        return NULL;
+    }
+};
+
+template <int N_LANG, int N_PREF, int N = N_BIN_REGIONS>
+struct SelectRegions {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        if (dims.n_regions == N) {
+            return SelectIdeologies<N_LANG, N_PREF, N>::select(dims);
+        }
+        return SelectRegions<N_LANG, N_PREF, N - 1>::select(dims);
+    }
+};
+
+template <int N_LANG, int N_PREF>
+struct SelectRegions<N_LANG, N_PREF, 0> {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        return NULL;
+    }
+};
+
+template <int N_LANG, int N = N_BIN_PREFERENCE_CLASS>
+struct SelectPreferenceClasses {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        if (dims.n_pref_classes == N) {
+            return SelectRegions<N_LANG, N>::select(dims);
+        }
+        return SelectPreferenceClasses<N_LANG, N - 1>::select(dims);
+    }
+};
+
+template <int N_LANG>
+struct SelectPreferenceClasses<N_LANG, 0> {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        return NULL;
+    }
+};
+
+template <int N = N_LANGS>
+struct SelectLanguages {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        if (dims.n_langs == N) {
+            return SelectPreferenceClasses<N>::select(dims);
+        }
+        return SelectLanguages<N - 1>::select(dims);
+    }
+};
+
+template <>
+struct SelectLanguages<0> {
+    static FollowerLayersFactory select(const FollowerSetDims& dims) {
+        return NULL;
+    }
+};
+
+FollowerLayersFactory follower_layers_factory(const FollowerSetDims& dims) {
+    FollowerLayersFactory factory = SelectLanguages<>::select(dims);
+    if (factory == NULL) {
+        factory = SelectLanguages<>::select(FollowerSetDims());
+    }
+    return factory;
+}
+
+void FollowerSetDims::include(const Agent& agent) {
+    n_langs = max(n_langs, agent.language + 1);
+    n_pref_classes = max(n_pref_classes, agent.preference_class + 1);
+    n_regions = max(n_regions, agent.region_bin + 1);
+    n_ideologies = max(n_ideologies, agent.ideology_bin + 1);
+}
+
+/*****************************************************************************
+ * FollowerSet implementation:
+ *****************************************************************************/
+
+FollowerSet::FollowerSet() {
+    layers_factory = follower_layers_factory(FollowerSetDims());
+}
+
+FollowerSet::~FollowerSet() {
+    delete layers;
+}
+
+void FollowerSet::set_layers_factory(FollowerLayersFactory factory) {
+    ASSERT(n_elems == 0, "Cannot change the layers of a non-empty follower set!");
+    delete layers;
+    layers = NULL;
+    layers_factory = factory;
+}
+
+bool FollowerSet::add(Agent& agent) {
+    if (layers == NULL) {
+        layers = layers_factory();
+    }
+    if (layers->add(agent)) {
+        n_elems++;
+        update_reach_counts(agent, +1);
+        return true;
+    }
+    return false;
+}
+
+size_t FollowerSet::add_all(std::vector<Agent*>& agents) {
+    if (agents.empty()) {
         return 0;
     }
-    // Sum over retweet weights of all the language layers and the sublayers contained within
+    if (layers == NULL) {
+        layers = layers_factory();
+    }
+    size_t n_added = layers->add_all(agents.data(), agents.size());
+    n_elems += n_added;
+    for (Agent* agent : agents) {
+        if (agent != NULL) {
+            update_reach_counts(*agent, +1);
+        }
+    }
+    return n_added;
+}
+
+bool FollowerSet::remove(Agent& agent) {
+    if (layers != NULL && layers->remove(agent)) {
+        n_elems--;
+        update_reach_counts(agent, -1);
+        return true;
+    }
+    return false;
+}
+
+void FollowerSet::clear() {
+    delete layers;
+    layers = NULL;
+    n_elems = 0;
+    memset(reach_counts, 0, sizeof(reach_counts));
+}
+
+void FollowerSet::for_each(const std::function<void(int)>& func) {
+    if (layers != NULL) {
+        layers->for_each(func);
+    }
+}
+
+bool FollowerSet::pick_random_weighted(MTwist rng, Weights& weights, int& id, const std::function<bool(int)>& is_excluded) {
+    if (layers == NULL) {
+        return false;
+    }
+    return layers->pick_weighted(rng, weights, id, is_excluded);
+}
+
+bool FollowerSet::pick_random_uniform(MTwist& rng, int& id) {
+    if (layers == NULL) {
+        return false;
+    }
+    return layers->pick_uniform(rng, id);
+}
+
+size_t FollowerSet::memory_usage() const {
+    return sizeof(*this) + (layers != NULL ? layers->memory_usage() : 0);
+}
+
+void FollowerSet::print() {
+    if (layers != NULL) {
+        layers->print();
+    }
+}
+
+void FollowerSet::post_load(AnalysisState& state) {
+    ASSERT(serialization_cache != NULL, "No serialization cache (from serialize)!");
+    std::vector<Agent*> agents;
+    agents.reserve(serialization_cache->size());
+    for (int agent_id : *serialization_cache) {
+        agents.push_back(&state.network[agent_id]);
+    }
+    add_all(agents);
+    delete serialization_cache;
+    serialization_cache = NULL;
+}
 
-    /* Start language weight sum calculation */
-    double total_lang_weight_sum = 0;
-    // Iterate over all possible spoken languages:
+/*****************************************************************************
+ * Cached reach counts, see 'total_tweet_weight':
+ *****************************************************************************/
+
+void FollowerSet::update_reach_counts(Agent& agent, int delta) {
     for (int i_lang = 0; i_lang < N_LANGS; i_lang++) {
-        if (!language_understandable((Language)i_lang, content.language)) {
-            continue;
+        if (language_understandable(agent.language, (Language)i_lang)) {
+            reach_counts[i_lang][agent.ideology_bin] += delta;
         }
-        /* Start preference class weight sum calculation */
-        double pref_class_weight_sum = 0;
-        auto& f_prefs = f_root.sublayers[i_lang];
-        auto& w_prefs = w_root.subweights[i_lang];
-        // Iterate all the preference class layers:
-        for (int i_pref = 0; i_pref < N_BIN_PREFERENCE_CLASS; i_pref++) {
-            auto& f_regions = f_prefs.sublayers[i_pref];
-            auto& w_regions = w_prefs.subweights[i_pref];
-            /* Start region weight sum calculation */
-            double region_weight_sum = 0;
-            // Iterate all the region layers:
-            for (int i_region = 0; i_region < N_BIN_REGIONS; i_region++) {
-                auto& f_ideo = f_regions.sublayers[i_region];
-                auto& w_ideo = w_regions.subweights[i_region];
-                /* Start leaf weight sum calculation */
-                double leaf_ideo_weight_sum = 0;
-                // Iterate all the leaf ideology layers:
-                for (int i_ideo = 0; i_ideo < N_BIN_IDEOLOGIES; i_ideo++) {
-                    TweetType type = content.type;
-                    if (type == TWEET_IDEOLOGICAL && i_ideo == content.ideology_bin) {
-                        type = TWEET_IDEOLOGICAL_DIFFERENT;
-                    }
-                    // Set the weight in the final layer:
-                    double leaf_weight = d_root.weights[i_ideo][type][author.agent_type] * f_ideo.sublayers[i_ideo].size();
-                    leaf_ideo_weight_sum += (w_ideo.weights[i_ideo] = leaf_weight);
-                }
-                region_weight_sum += (w_ideo.total_weight = leaf_ideo_weight_sum);
-                /* End leaf  ideology weight sum calculation */
-                assert_weight_integrity(f_ideo, w_ideo);
-            }
-            pref_class_weight_sum += (w_regions.total_weight = region_weight_sum);
-            /* End region weight sum calculation */
-            assert_weight_integrity(f_regions, w_regions);
+    }
+}
+
+double FollowerSet::determine_tweet_weights(Agent& author, TweetContent& content, WeightDeterminer& d_root, /*Weights placed here:*/ Weights& w_root) {
+    PERF_TIMER();
+    DEBUG_CHECK(content.language != LANG_FRENCH_AND_ENGLISH, "Invalid tweet language!");
+
+    if (n_elems == 0) {
+        return 0;
+    }
+    double total_weight = layers->determine_tweet_weights(author, content, d_root, w_root);
+    DEBUG_CHECK(fabs(total_tweet_weight(author, content, d_root) - total_weight) <= 1e-9 * total_weight,
+            "Cached reach counts out of sync with the follower layers!");
+    return total_weight;
+}
+
+double FollowerSet::exclude_tweet_weight(int leaf_key, int count, Agent& author, TweetContent& content, WeightDeterminer& d_root, Weights& w_root) {
+    if (n_elems == 0) {
+        return 0;
+    }
+    return layers->exclude_tweet_weight(leaf_key, count, author, content, d_root, w_root);
+}
+
+int FollowerSet::leaf_key(const Agent& agent) {
+    return ((agent.language * N_BIN_PREFERENCE_CLASS + agent.preference_class) * N_BIN_REGIONS + agent.region_bin)
+            * N_BIN_IDEOLOGIES + agent.ideology_bin;
+}
+
+double FollowerSet::follower_tweet_weight(Agent& follower, Agent& author, TweetContent& content, WeightDeterminer& d_root) {
+    if (!language_understandable(follower.language, content.language)) {
+        return 0;
+    }
+    WeightContext context = {author, content, d_root, follower.ideology_bin};
+    return leaf_weight(context);
+}
+
+double FollowerSet::total_tweet_weight(Agent& author, TweetContent& content, WeightDeterminer& d_root) {
+    DEBUG_CHECK(content.language != LANG_FRENCH_AND_ENGLISH, "Invalid tweet language!");
+
+    // Mirrors the leaf weight of determine_tweet_weights, summed over the
+    // language, preference class and region layers ahead of time:
+    int* counts = reach_counts[content.language];
+    double total_weight = 0;
+    for (int i_ideo = 0; i_ideo < N_BIN_IDEOLOGIES; i_ideo++) {
+        TweetType type = content.type;
+        if (type == TWEET_IDEOLOGICAL && i_ideo == content.ideology_bin) {
+            type = TWEET_IDEOLOGICAL_DIFFERENT;
         }
-        total_lang_weight_sum += (w_prefs.total_weight = pref_class_weight_sum);
-        /* End preference class weight sum calculation */
-        assert_weight_integrity(f_prefs, w_prefs);
-    }
-    /* End language weight sum calculation */
-    w_root.total_weight = total_lang_weight_sum;
-    assert_weight_integrity(f_root, w_root);
-    return total_lang_weight_sum;
+        total_weight += d_root.weights[i_ideo][type][author.agent_type] * counts[i_ideo];
+    }
+    return total_weight;
 }
@@ -46,83 +46,40 @@ struct TweetContent;
  * The categorization layers are:
  *   Language
  *   X Preference class
+ *   X Region
  *   X Ideology
  *
  * The weight determiner layers are:
  *   Agent preference class
  *   X Tweet type (for ideological tweets, whether ideologies match)
  *   X Original tweeter agent type
+ *
+ * The layers are instantiated for the number of bins actually configured
+ * in each dimension (see FollowerSetDims), and dimensions with a single bin
+ * are left out of the layer stack altogether. The implementation lives in
+ * FollowerSet.cpp, behind the FollowerLayers interface.
  *****************************************************************************/
 
-// Leaf layer
-struct IdeologyLayer {
-    static const int N_SUBLAYERS = N_BIN_IDEOLOGIES;
-
-    struct Weights {
-        double weights[N_SUBLAYERS] = {0};
-        double total_weight = 0;
-    };
-
-    static int classify(Agent& agent);
-
-    int n_elems = 0; // Total
-    HashedEdgeSet<int> sublayers[N_SUBLAYERS];
-};
-
-struct RegionLayer {
-    typedef IdeologyLayer ChildLayer;
-    static const int N_SUBLAYERS = N_BIN_REGIONS;
-
-    struct Weights {
-        ChildLayer::Weights subweights[N_SUBLAYERS];
-        double total_weight = 0;
-    };
-
-    static int classify(Agent& agent);
+// The number of bins in use in each categorization layer.
+// Every agent added to a follower set must fall within these.
+struct FollowerSetDims {
+    int n_langs = N_LANGS;
+    int n_pref_classes = N_BIN_PREFERENCE_CLASS;
+    int n_regions = N_BIN_REGIONS;
+    int n_ideologies = N_BIN_IDEOLOGIES;
 
-    int n_elems = 0; // Total
-    ChildLayer sublayers[N_SUBLAYERS];
+    // Widen the dimensions to fit 'agent'.
+    void include(const Agent& agent);
 };
 
-struct PreferenceClassLayer {
-    typedef RegionLayer ChildLayer;
-    static const int N_SUBLAYERS = N_BIN_PREFERENCE_CLASS;
-
-    struct Weights {
-        ChildLayer::Weights subweights[N_SUBLAYERS];
-        double total_weight = 0;
-    };
-
-    static int classify(Agent& agent);
-
-    int n_elems = 0; // Total
-    ChildLayer sublayers[N_SUBLAYERS];
-};
-
-// Top layer
-struct LanguageLayer {
-    typedef PreferenceClassLayer ChildLayer;
-    static const int N_SUBLAYERS = N_LANGS;
-
-    struct Weights {
-        ChildLayer::Weights subweights[N_SUBLAYERS];
-        double total_weight = 0;
-
-        template <typename Archive>
-        void save(Archive& ar) const {
-            ar.saveBinary(this, sizeof(*this));
-        }
-        template <typename Archive>
-        void load(Archive& ar) {
-            ar.loadBinary(this, sizeof(*this));
-        }
-    };
+// Number of doubles in the weights of the largest layer stack (leaves hold a weight and an excluded count):
+const int MAX_FOLLOWER_SET_WEIGHTS = (((N_BIN_IDEOLOGIES * 2 + 1) * N_BIN_REGIONS + 1) * N_BIN_PREFERENCE_CLASS + 1) * N_LANGS + 1;
 
-    static int classify(Agent& agent);
+struct FollowerLayers;
+typedef FollowerLayers* (*FollowerLayersFactory)();
 
-    int n_elems = 0; // Total
-    ChildLayer sublayers[N_SUBLAYERS];
-};
+// The layer stack specialized for 'dims'. Returns the full stack if 'dims' is out of bounds.
+FollowerLayersFactory follower_layers_factory(const FollowerSetDims& dims);
 
 /*****************************************************************************
  * Implementation of the follower set:
@@ -130,8 +87,12 @@ struct LanguageLayer {
 
 struct FollowerSet {
     const static int MAGIC_CONSTANT_BEFORE_SERIALIZATION = 0xbadbeef;
-    typedef LanguageLayer TopLayer;
-    typedef TopLayer::Weights Weights;
+
+    // Per-tweet scratch space for the reaction weights of each layer bin,
+    // filled by determine_tweet_weights and consumed by pick_random_weighted.
+    struct Weights {
+        alignas(double) char storage[MAX_FOLLOWER_SET_WEIGHTS * sizeof(double)];
+    };
 
     // Weights for determining whether a tweet has a reaction (follow/retweet).
     // Note that this is primarily decided by a tweet type, observer preference class,
@@ -148,23 +109,13 @@ struct FollowerSet {
         double get_weight(Agent& author, TweetContent& content);
     };
 
-    template <typename Function>
-    void for_each(Function func) {
-        // Reach into all the layers:
-        auto& a = followers;
-        for (auto& b : a.sublayers) {
-            for (auto& c : b.sublayers) {
-                for (auto& d : c.sublayers) {
-                    for (HashedEdgeSet<int>& set : d.sublayers) {
-                        HashedEdgeSet<int>::iterator iter;
-                        while (set.iterate(iter)) {
-                            func(iter.get());
-                        }
-                    }
-                }
-            }
-        }
-    }
+    FollowerSet();
+    ~FollowerSet();
+
+    // Select the layer stack used once followers are added. The set must be empty.
+    void set_layers_factory(FollowerLayersFactory factory);
+
+    void for_each(const std::function<void(int)>& func);
     std::vector<int> as_vector() {
         std::vector<int> vec;
         for_each([&](int agent_id) {
@@ -176,11 +127,19 @@ struct FollowerSet {
     /* Returns false if the element already existed */
     bool add(Agent& agent);
 
+    /* Adds many agents at once, each leaf of the layers in one batch, sized up front.
+     * Reorders 'agents', and clears the entries that already existed. Returns the number added. */
+    size_t add_all(std::vector<Agent*>& agents);
+
     /* Returns true if the element already existed */
     bool remove(Agent& agent);
 
-    /* Returns an element, provided the given weights */
-    bool pick_random_weighted(MTwist rng, Weights& weights, int& id_result);
+    /* Remove all elements, keeping the layer stack selection */
+    void clear();
+
+    /* Returns an element, provided the given weights. Never returns an element for which 'is_excluded' holds,
+     * these should have been removed from the weights with exclude_tweet_weight. */
+    bool pick_random_weighted(MTwist rng, Weights& weights, int& id_result, const std::function<bool(int)>& is_excluded);
 
     /* Returns an element, weighing all options equally */
     bool pick_random_uniform(MTwist& rng, int& id);
@@ -188,11 +147,28 @@ struct FollowerSet {
     void print();
 
     size_t size() const {
-        return followers.n_elems;
+        return n_elems;
     }
 
+    // Approximate bytes held, including the set object itself.
+    size_t memory_usage() const;
+
     double determine_tweet_weights(Agent& author, TweetContent& content, WeightDeterminer& determiner, /*Weights placed here: */ Weights& output);
 
+    // Removes 'count' followers of the leaf 'leaf_key', that can no longer react to the tweet, from weights
+    // filled by determine_tweet_weights. Returns the new total weight.
+    double exclude_tweet_weight(int leaf_key, int count, Agent& author, TweetContent& content, WeightDeterminer& determiner, Weights& weights);
+
+    // Identifies the leaf of the layers that 'agent' belongs in, whichever layer stack is selected.
+    static int leaf_key(const Agent& agent);
+
+    // Returns the same total as determine_tweet_weights, but from the cached reach counts,
+    // without descending into the layers or filling out a Weights object.
+    double total_tweet_weight(Agent& author, TweetContent& content, WeightDeterminer& determiner);
+
+    // The share of a single follower in total_tweet_weight.
+    static double follower_tweet_weight(Agent& follower, Agent& author, TweetContent& content, WeightDeterminer& determiner);
+
     // Do a 'flexible' serialization, upholding semantic meaning but not exact binary compability, allowing for reloading differing configs. 
     // Note that because exact binary compatibility is not held, stopping a network has a reshuffling effect on data.
     // This does not affect the validity of rates, but does mean that serializing a network does not cause it to resume in exactly the same way.
@@ -221,10 +197,42 @@ struct FollowerSet {
 
     void post_load(AnalysisState& state);
 private:
-    // Holds the actual followers:
-    TopLayer followers;
+    // Keeps 'reach_counts' in sync with an added (delta = 1) or removed (delta = -1) follower.
+    void update_reach_counts(Agent& agent, int delta);
+
+    // Holds the actual followers; allocated on the first add, most agents never gain followers.
+    FollowerLayers* layers = NULL;
+    FollowerLayersFactory layers_factory;
+    int n_elems = 0;
+    // Cached reaction summary, maintained on add/remove.
+    // For each tweet language, the number of followers in each ideology bin that can understand it.
+    // Together with the (tweet type, author agent type) entry of the WeightDeterminer,
+    // this is all that is needed for the total reaction weight of a tweet.
+    int reach_counts[N_LANGS][N_BIN_IDEOLOGIES] = {{0}};
     // For serialization:
-    std::vector<int>* serialization_cache;
+    std::vector<int>* serialization_cache = NULL;
+
+    // Non-copyable, the layers are owned:
+    FollowerSet(const FollowerSet&);
+    FollowerSet& operator=(const FollowerSet&);
+};
+
+// The categorization layers of one follower set, specialized for a FollowerSetDims.
+struct FollowerLayers {
+    virtual ~FollowerLayers() {
+    }
+    virtual bool add(Agent& agent) = 0;
+    virtual size_t add_all(Agent** agents, size_t n) = 0;
+    virtual bool remove(Agent& agent) = 0;
+    virtual bool pick_weighted(MTwist& rng, FollowerSet::Weights& weights, int& id, const std::function<bool(int)>& is_excluded) = 0;
+    virtual bool pick_uniform(MTwist& rng, int& id) = 0;
+    virtual void for_each(const std::function<void(int)>& func) = 0;
+    virtual double determine_tweet_weights(Agent& author, TweetContent& content,
+            FollowerSet::WeightDeterminer& determiner, FollowerSet::Weights& output) = 0;
+    virtual double exclude_tweet_weight(int leaf_key, int count, Agent& author, TweetContent& content,
+            FollowerSet::WeightDeterminer& determiner, FollowerSet::Weights& weights) = 0;
+    virtual size_t memory_usage() const = 0;
+    virtual void print() = 0;
 };
 
 #endif /* FOLLOWERSET_H_ */
@@ -43,10 +43,28 @@ struct FollowingSet {
         return implementation.as_vector();
     }
 
+    // Visit every followed agent, without copying them out first.
+    template <typename Func>
+    void for_each(Func func) {
+        Followings::iterator iter;
+        while (implementation.iterate(iter)) {
+            func(iter.get());
+        }
+    }
+
     bool add(AnalysisState& S, int id) {
         return implementation.insert(id);
     }
 
+    void reserve(size_t n) {
+        implementation.reserve(n);
+    }
+
+    // Add 'n' followed agents at once. Returns the number not already followed.
+    size_t add_all(AnalysisState& S, const int* ids, size_t n) {
+        return implementation.insert_all(ids, n);
+    }
+
     bool remove(AnalysisState& S, int id) {
         return implementation.erase(id);
     }
@@ -64,6 +82,11 @@ struct FollowingSet {
         return implementation.size();
     }
 
+    // Approximate bytes held, including the set object itself.
+    size_t memory_usage() const {
+        return sizeof(*this) - sizeof(implementation) + implementation.memory_usage();
+    }
+
     template <typename Archive>
     void save(Archive& ar) const {
         ar( cereal::make_size_tag( size() ) );
@@ -76,6 +99,8 @@ struct FollowingSet {
     void load(Archive& ar) {
         size_t size;
         ar( cereal::make_size_tag( size ) );
+        // Sized from the saved count, rather than growing edge by edge:
+        implementation.reserve(size);
         for (size_t i = 0; i < size ; i++) {
             int edge;
             ar(edge);
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors.
+ */
+
+#ifndef PREFERENTIALSAMPLER_H_
+#define PREFERENTIALSAMPLER_H_
+
+#include <vector>
+#include <cmath>
+
+#include "util.h"
+#include "util/FenwickTree.h"
+
+// Exact preferential attachment: picks agent 'i' with probability proportional to
+// (degree_i + 1)^exponent, over every agent in the network.
+//
+// The per-agent weights are held in a growable Fenwick tree, so adding an agent,
+// changing a degree, and drawing an agent are all O(log n).
+struct PreferentialSampler {
+    void set_exponent(double exponent) {
+        this->exponent = exponent;
+    }
+
+    int size() const {
+        return weights.size();
+    }
+
+    void clear() {
+        weights.clear();
+        tree.clear();
+        n_updates = 0;
+    }
+
+    double degree_weight(int degree) const {
+        if (exponent == 1.0) {
+            return degree + 1;
+        }
+        return pow(degree + 1, exponent);
+    }
+
+    // Append the next agent id, i.e. size().
+    void add_agent(int degree) {
+        double weight = degree_weight(degree);
+        weights.push_back(weight);
+        tree.push_back(weight);
+    }
+
+    void set_degree(int id, int degree) {
+        DEBUG_CHECK(id >= 0 && id < size(), "Agent not in preferential sampler!");
+        double weight = degree_weight(degree);
+        tree.add(id, weight - weights[id]);
+        weights[id] = weight;
+        // Periodically rebuild, to bound floating-point drift:
+        if (++n_updates >= MIN_REBUILD_PERIOD && n_updates >= size()) {
+            tree.assign(weights);
+            n_updates = 0;
+        }
+    }
+
+    double total_weight() const {
+        return tree.total();
+    }
+
+    // Pick an agent id, given 'rand_num' uniform in (0, 1]. Returns -1 if empty.
+    int pick(double rand_num) const {
+        if (weights.empty()) {
+            return -1;
+        }
+        return tree.find(rand_num * tree.total());
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) - sizeof(tree) + tree.memory_usage() + weights.capacity() * sizeof(double);
+    }
+
+private:
+    static const int MIN_REBUILD_PERIOD = 1 << 16;
+
+    double exponent = 1.0;
+    std::vector<double> weights;
+    FenwickTree tree;
+    int n_updates = 0;
+};
+
+#endif
@@ -350,6 +350,27 @@ struct RateTree {
         return vec;
     }
 
+    // Calls func(node) for each leaf, without collecting them first.
+    template <typename Function>
+    void for_each_leaf(Function func) {
+        if (node_pool[0].is_allocated) {
+            for_each_leaf(node_pool[0], func);
+        }
+    }
+    template <typename Function>
+    void for_each_leaf(Node& node, Function& func) {
+        if (node.is_leaf) {
+            func(node);
+            return;
+        }
+        for (int i = 0; i < N_CHILDREN; i++) {
+            int c = node.children[i];
+            if (c != INVALID) {
+                for_each_leaf(get(c), func);
+            }
+        }
+    }
+
     std::vector<T> as_vector() {
         std::vector<Node*> node_vec = as_node_vector();
         std::vector<T> vec;
@@ -428,6 +449,18 @@ struct RateTree {
         return n_elems;
     }
 
+    // Approximate bytes held by the tree structure, including the tree object itself.
+    // Heap storage owned by the leaf data (if any) is not included.
+    size_t memory_usage() const {
+        size_t usage = sizeof(*this) + node_pool.capacity() * sizeof(Node)
+                + free_list.capacity() * sizeof(ref_t)
+                + vacancy_list.capacity() * sizeof(ref_list);
+        for (auto& list : vacancy_list) {
+            usage += list.capacity() * sizeof(ref_t);
+        }
+        return usage;
+    }
+
     template <typename Archive>
     void serialize(Archive& ar) {
         ar(n_elems, free_list); //Freed nodes
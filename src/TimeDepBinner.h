@@ -69,6 +69,10 @@ struct TimeDepBin {
     size_t size() {
         return heap.size();
     }
+    // Bytes held by the heap storage (the bin object itself is not included).
+    size_t heap_memory_usage() const {
+        return heap.capacity() * sizeof(int);
+    }
     bool empty() {
         return heap.empty();
     }
@@ -117,6 +121,15 @@ public:
         return bins;
     }
 
+    // Approximate bytes held, including the binner object itself.
+    size_t memory_usage() const {
+        size_t usage = sizeof(*this) + bins.capacity() * sizeof(TimeDepBin);
+        for (auto& bin : bins) {
+            usage += bin.heap_memory_usage();
+        }
+        return usage;
+    }
+
     template <typename Archive>
     void serialize(Archive& ar) {
         ar(bins);
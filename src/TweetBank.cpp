@@ -47,7 +47,7 @@ double TweetRateDeterminer::get_cat_threshold(int bin) {
 
 TweetReactRateVec TweetRateDeterminer::get_rate(const Tweet& tweet, int bin) {
     Agent& agent = state.network[tweet.id_tweeter];
-    FollowerSet& followers = agent.follower_set;
+    FollowerSet& followers = agent.follower_set();
 
     /********************************************************************
      * Determine the 'Omega' observation PDF.
@@ -64,10 +64,10 @@ TweetReactRateVec TweetRateDeterminer::get_rate(const Tweet& tweet, int bin) {
      * We scale by 'obs_prob'.
      ********************************************************************/
 
-    // Assumption: react_weights is initialized to the appropriate
-    // weights for this tweet.
+    // Assumption: react_weight is initialized to the appropriate
+    // total weight for this tweet.
 
-    return TweetReactRateVec(obs_prob * tweet.react_weights.total_weight);
+    return TweetReactRateVec(obs_prob * tweet.react_weight);
 }
 
 void appendOldTweet(AnalysisState& state, Tweet& t) {
@@ -90,6 +90,7 @@ bool TimeDepRateTree::ElementChecker::check(ref_t id) {
             //                    printf("BOOTING NODE %d AT BIN %d\n", id,  t.retweet_time_bin);
             // Here is the hook, the tweet with id = id is about to be kicked
             appendOldTweet(state, t);
+            state.tweet_bank.deactivate(t);
             tree.tree.remove(id);
         } else {
             //                    printf("MOVING TO BIN %d\n", t.retweet_time_bin);
@@ -28,6 +28,7 @@
 #include <cmath>
 #include <vector>
 #include <set>
+#include <unordered_map>
 #include <google/sparse_hash_set>
 
 #include "RateTree.h"
@@ -91,6 +92,12 @@ struct TimeDepRateTree {
         return tree.get(ref);
     }
 
+    // Recompute the rate of an element, after its reaction weight changed.
+    void refresh_rate(ref_t ref) {
+        Tweet& t = tree.get(ref).data;
+        tree.replace_rate(ref, determiner.get_rate(t, t.retweet_time_bin));
+    }
+
     TweetReactRateVec rate_summary() {
         return tree.rate_summary();
     }
@@ -118,6 +125,10 @@ struct TimeDepRateTree {
     std::vector<TweetRateTree::Node*> as_node_vector() {
         return tree.as_node_vector();
     }
+    template <typename Function>
+    void for_each_leaf(Function func) {
+        tree.for_each_leaf(func);
+    }
 
     std::vector<Tweet> as_vector() {
         return tree.as_vector();
@@ -143,6 +154,11 @@ struct TimeDepRateTree {
     int n_bins() {
         return binner.get_bins().size();
     }
+
+    // Approximate bytes held by the rate tree and time binner, including this object itself.
+    size_t memory_usage() const {
+        return sizeof(*this) - sizeof(tree) - sizeof(binner) + tree.memory_usage() + binner.memory_usage();
+    }
 private:
 
     struct ElementChecker {
@@ -203,7 +219,34 @@ struct TweetBank {
      */
     void add(const Tweet& data) {
         PERF_TIMER();
-        tree.add(data);
+        ref_t ref = tree.add(data);
+        index(ref);
+    }
+
+    // Forget an active tweet about to be removed from the tree.
+    void deactivate(const Tweet& tweet) {
+        erase_ref(tweet.content->active_tweets, tweet.content_slot, &Tweet::content_slot);
+        auto iter = tweeter_tweets.find(tweet.id_tweeter);
+        DEBUG_CHECK(iter != tweeter_tweets.end(), "Tweet was not active!");
+        erase_ref(iter->second, tweet.tweeter_slot, &Tweet::tweeter_slot);
+        if (iter->second.empty()) {
+            tweeter_tweets.erase(iter);
+        }
+    }
+
+    // The active tweets of an agent, or NULL if it has none.
+    const std::vector<int>* tweets_of(int id_tweeter) const {
+        auto iter = tweeter_tweets.find(id_tweeter);
+        return (iter == tweeter_tweets.end()) ? NULL : &iter->second;
+    }
+
+    Tweet& get(ref_t ref) {
+        return tree.get(ref).data;
+    }
+
+    // Recompute the rate of a tweet, after its react_weight changed.
+    void refresh_rate(ref_t ref) {
+        tree.refresh_rate(ref);
     }
 
     std::vector<TweetRateTree::Node*> as_node_vector() {
@@ -224,6 +267,18 @@ struct TweetBank {
     int n_active_tweets() const {
         return tree.size();
     }
+
+    // Approximate bytes held by the tweet bank, including the active tweets' share of their content.
+    size_t memory_usage() {
+        size_t usage = sizeof(*this) - sizeof(tree) + tree.memory_usage();
+        for (auto& entry : tweeter_tweets) {
+            usage += sizeof(entry) + entry.second.capacity() * sizeof(int);
+        }
+        tree.for_each_leaf([&](TweetRateTree::Node& node) {
+            usage += node.data.content_memory_usage() + node.data.excluded.capacity() * sizeof(ExcludedCount);
+        });
+        return usage;
+    }
     Tweet& pick_random_weighted(MTwist& rng) {
         ref_t ref = tree.pick_random_weighted(rng);
         return tree.get(ref).data;
@@ -232,7 +287,37 @@ struct TweetBank {
     template <typename Archive>
     void serialize(Archive& ar) {
         tree.serialize(ar);
+        // Content does not serialize its active tweets, nor are the tweeters' indexed:
+        tweeter_tweets.clear();
+        tree.for_each_leaf([&](TweetRateTree::Node& node) {
+            node.data.content->active_tweets.clear();
+        });
+        tree.for_each_leaf([&](TweetRateTree::Node& node) {
+            index(&node - &tree.get(0));
+        });
     }
+private:
+    // Lists an active tweet with its content and its tweeter, remembering where, for O(1) removal.
+    void index(ref_t ref) {
+        Tweet& tweet = get(ref);
+        std::vector<int>& content_refs = tweet.content->active_tweets;
+        tweet.content_slot = content_refs.size();
+        content_refs.push_back(ref);
+        std::vector<int>& tweeter_refs = tweeter_tweets[tweet.id_tweeter];
+        tweet.tweeter_slot = tweeter_refs.size();
+        tweeter_refs.push_back(ref);
+    }
+
+    // Removes the reference at 'slot' by moving the last one in its place, whose position 'slot_of' is updated.
+    void erase_ref(std::vector<int>& refs, int slot, int Tweet::* slot_of) {
+        DEBUG_CHECK(slot >= 0 && slot < refs.size(), "Tweet was not active!");
+        refs[slot] = refs.back();
+        get(refs[slot]).*slot_of = slot;
+        refs.pop_back();
+    }
+
+    // The active tweets of each agent that has any, so that unfollows can find them.
+    std::unordered_map<int, std::vector<int>> tweeter_tweets;
 };
 
 #endif
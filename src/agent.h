@@ -47,66 +47,91 @@
 // Forward declare, to prevent circular header inclusion:
 struct AnalysisState;
 
-struct Agent {
-    // Storing the id is somewhat redundant (since it can be inferred from Agent address), but provides convenient handling
-    int id = -1;
-    int agent_type = -1;
-    int preference_class = -1;
-    int n_tweets = 0, n_retweets = 0;
-
-    // Abstract location:
-    int region_bin = -1;
-
+/* The rarely touched bookkeeping of an agent. Kept in its own array of each AgentBlock,
+ * apart from the Agent records that are scanned on every event. */
+struct AgentDetails {
     double ideology_tweet_percent = 0;
-    double creation_time = 0;
 
     // this is the average chatiness of the agents following list
     double avg_chatiness = 0.0;
-    Language language = (Language)-1;
-
-   // Abstract ideology:
-    int ideology_bin = -1;
 
     //Introducing Susceptibility
     double susceptibility = 1.0;
-    
+
     // list of flagged chatty people
     std::vector<int> chatty_agents;
 
-    // Store the two directions of the follow relationship
-    FollowingSet following_set;
-    FollowerSet follower_set;
-
     // these store how someone followed you, or how you followed someone
-    std::vector<int> following_method_counts = std::vector<int>(N_FOLLOW_MODELS);
-    std::vector<int> follower_method_counts = std::vector<int>(N_FOLLOW_MODELS);
+    int following_method_counts[N_FOLLOW_MODELS] = {0};
+    int follower_method_counts[N_FOLLOW_MODELS] = {0};
+};
+
+/* Agent records only hold the fields read on every event. The bookkeeping (see AgentDetails)
+ * and the two (large) follow structures are stored in separate arrays of the agent's block,
+ * and found from the agent's id (see network.h). Agents therefore only exist within the
+ * Network, and are never copied. */
+struct Agent {
+    Agent() = default;
+    Agent(const Agent&) = delete;
+    Agent& operator=(const Agent&) = delete;
+
+    // Set by the Network, and locates the rest of the agent within its block
+    int id = -1;
+
+    int agent_type = -1;
+    int preference_class = -1;
+    // Abstract location:
+    int region_bin = -1;
+    // Abstract ideology:
+    int ideology_bin = -1;
+    Language language = (Language)-1;
+    double creation_time = 0;
+    int n_tweets = 0, n_retweets = 0;
+
+    // Owned by the Network, defined in network.h:
+    AgentDetails& details();
+    const AgentDetails& details() const;
+    // Store the two directions of the follow relationship
+    FollowingSet& following_set();
+    const FollowingSet& following_set() const;
+    FollowerSet& follower_set();
+    const FollowerSet& follower_set() const;
 
     // For streaming agent data in JSON
     void api_serialize(cereal::JSONOutputArchive& ar, bool serialize_follow_sets = false);
 
+    // Approximate bytes held by the agent record and its details, excluding its follow sets
+    // (see FollowingSet::memory_usage and FollowerSet::memory_usage).
+    size_t memory_usage() const {
+        return sizeof(*this) + sizeof(AgentDetails) + details().chatty_agents.capacity() * sizeof(int);
+    }
+
     template <typename Archive>
     void serialize(Archive& ar) {
+        AgentDetails& details = this->details();
         ar(NVP(id), NVP(agent_type), NVP(preference_class)
           , NVP(n_tweets), NVP(n_retweets)
           , NVP(region_bin)
-          , NVP(ideology_tweet_percent), NVP(creation_time)
-          , NVP(avg_chatiness)
+          , cereal::make_nvp("ideology_tweet_percent", details.ideology_tweet_percent), NVP(creation_time)
+          , cereal::make_nvp("avg_chatiness", details.avg_chatiness)
           , NVP(language)
           , NVP(ideology_bin)
-          , NVP(chatty_agents)
-          , NVP(following_set)
-          , NVP(follower_set)
-          , NVP(following_method_counts)
-          , NVP(follower_method_counts));
+          , cereal::make_nvp("chatty_agents", details.chatty_agents)
+          , cereal::make_nvp("following_set", following_set())
+          , cereal::make_nvp("follower_set", follower_set())
+          , cereal::make_nvp("following_method_counts", details.following_method_counts)
+          , cereal::make_nvp("follower_method_counts", details.follower_method_counts));
         check_magic(ar, 0x4444);
     }
 
     void post_load(AnalysisState& state) {
-        follower_set.post_load(state);
-        following_set.post_load(state);
+        follower_set().post_load(state);
+        following_set().post_load(state);
     }
 };
 
+static_assert(sizeof(Agent) <= 64, "Agent records should fit in a cache line!");
+
 struct AgentStats {
     int64 n_follows = 0, n_followers = 0, n_tweets = 0, n_original_tweets = 0, n_retweets = 0, n_unfollows = 0;
     int64 n_followback = 0;
@@ -154,6 +179,11 @@ struct TimeBinnedAgentList {
         ar(NVP(agent_ids), NVP(agent_ids_time_caps), NVP(last_seen_n_months));
     }
 
+    // Approximate bytes held, including the list object itself.
+    size_t memory_usage() const {
+        return sizeof(*this) + agent_ids.capacity() * sizeof(int) + agent_ids_time_caps.capacity() * sizeof(int);
+    }
+
     Range month_range(int i) {
         size_t previous_cap = (i == 0) ? 0 : agent_ids_time_caps[i - 1];
         size_t current_cap = (i == last_seen_n_months) ? agent_ids.size() : agent_ids_time_caps[i];
@@ -209,7 +239,6 @@ struct AgentType {
     bool care_about_region = false, care_about_ideology = false;
     TimeBinnedAgentList agents;
     CategoryGrouper follow_ranks;
-    std::vector<double> updating_probs;
     double tweet_type_probs[N_TWEET_TYPES];
 
     //Introducing Susceptibility
@@ -246,7 +275,7 @@ struct AgentType {
         ar(NVP(care_about_region), NVP(care_about_ideology));
         ar(NVP(agents));
         ar(NVP(follow_ranks));
-        ar(NVP(updating_probs), NVP(stats));
+        ar(NVP(stats));
         for (auto& ttp : tweet_type_probs) {
             ar(ttp);
         }
@@ -45,6 +45,10 @@ extern "C" {
 
 #include "serialization.h"
 #include "TweetBank.h"
+#include "PreferentialSampler.h"
+#include "CheckpointLog.h"
+#include "DegreeHistograms.h"
+#include "util/AliasTable.h"
 
 extern volatile int SIGNAL_ATTEMPTS;
 
@@ -78,6 +82,73 @@ struct NetworkStats {
     }
 };
 
+// Approximate memory held by each subsystem of the simulation, in bytes.
+// Filled by analyzer_memory_usage.
+struct MemoryUsage {
+    size_t agents = 0; // Agent records, excluding their follow sets
+    size_t following_sets = 0, follower_sets = 0;
+    size_t categories = 0; // Tweet, follow and retweet ranks, and the agent type lists
+    size_t tweet_bank = 0, old_tweets = 0;
+    size_t hashtags = 0;
+
+    // Peak resident set size of the process, for comparison with the total.
+    // Not a subsystem, and not included in the total.
+    size_t peak_resident = 0;
+
+    size_t total() const {
+        return agents + following_sets + follower_sets + categories + tweet_bank + old_tweets + hashtags;
+    }
+
+    // Calls func(name, bytes) for each subsystem, in a fixed order.
+    template <typename Function>
+    void for_each(Function func) const {
+        func("Agents", agents);
+        func("Following Sets", following_sets);
+        func("Follower Sets", follower_sets);
+        func("Categories", categories);
+        func("Tweet Bank", tweet_bank);
+        func("Old Tweets", old_tweets);
+        func("Hashtags", hashtags);
+    }
+};
+
+// Alias tables for the categorical draws whose weights are fixed by the configuration.
+// Built from the config, and rebuilt whenever rates are synchronized from a loaded configuration.
+struct ConfigAliasTables {
+    AliasTable region_add; // Region of a new agent
+    // Per region:
+    std::vector<AliasTable> region_ideology, region_language, region_preference_class;
+    AliasTable agent_type_add; // Agent type of a new agent
+    // Per agent type:
+    std::vector<AliasTable> agent_type_tweet_type;
+    AliasTable follow_model; // For the 'twitter' follow model
+
+    void build(ParsedConfig& config) {
+        auto& R = config.regions;
+        region_add.build(R.add_probs);
+        region_ideology.resize(R.regions.size());
+        region_language.resize(R.regions.size());
+        region_preference_class.resize(R.regions.size());
+        for (int i = 0; i < R.regions.size(); i++) {
+            region_ideology[i].build(R.regions[i].ideology_probs);
+            region_language[i].build(R.regions[i].language_probs);
+            region_preference_class[i].build(R.regions[i].preference_class_probs);
+        }
+
+        std::vector<double> prob_add;
+        agent_type_tweet_type.resize(config.agent_types.size());
+        for (int i = 0; i < config.agent_types.size(); i++) {
+            AgentType& type = config.agent_types[i];
+            prob_add.push_back(type.prob_add);
+            agent_type_tweet_type[i].build(type.tweet_type_probs, N_TWEET_TYPES);
+        }
+        agent_type_add.build(prob_add);
+
+        follow_model.build(config.model_weights.empty() ? NULL : &config.model_weights[0],
+                std::min((int)config.model_weights.size(), (int)N_TWITTER_FOLLOW_MODELS));
+    }
+};
+
 // Records in the AgentStats member found both in the agent type struct and global struct:
 #define RECORD_STAT(state, agent_type, stat) \
     state.agent_types[agent_type].stats. stat ++; \
@@ -99,6 +170,14 @@ struct InteractiveModeState {
     double sim_time_target = 0;
 };
 
+struct AnalysisState;
+
+// A follow routine specialized for one configuration, see analyzer_follow_kernel.
+typedef bool (*FollowKernel)(AnalysisState& state, int agent, double time_of_follow);
+
+// Select the follow kernel specialized for the follow model and follow options in 'config'.
+FollowKernel analyzer_follow_kernel(const ParsedConfig& config);
+
 // All the state passed to - and - from analyze.cpp.
 // Essentially this encapsulates all the information required for the post-analysis routines.
 // This is 'conceptually cleaner' than passing along the entire contents of the Analyzer struct.
@@ -129,6 +208,24 @@ struct AnalysisState {
     CategoryGrouper follow_ranks;
     CategoryGrouper retweet_ranks;
 
+    // O(1) samplers for the static distributions in 'config':
+    ConfigAliasTables alias_tables;
+
+    // Exact (degree + 1)^barabasi_exponent sampler over all agents, maintained when use_barabasi is set.
+    // Derived from the network, not serialized.
+    PreferentialSampler preferential_sampler;
+
+    // Changes since the last checkpoint, when analysis.checkpoint_interval is set.
+    // Not serialized; a run always starts its checkpoints with a full snapshot.
+    CheckpointLog checkpoints;
+
+    // Agents by degree, when output.degree_distributions is set.
+    // Derived from the network, not serialized.
+    DegreeHistograms degree_histograms;
+
+    // The follow routine specialized for 'config', selected once rather than on every follow.
+    FollowKernel follow_kernel;
+
     // Our distinct agent classes.
     // Agent probabilities are derived from config,
     // while the list of users within is derived from
@@ -170,11 +267,10 @@ struct AnalysisState {
      in the social network. This can result in information passing across the 
      entire network. 
      
-     A small window of 'tweets' are kept for each topic, and every agent has
-     a chance of propagating a given tweet in their own immediate network. */
+     A small window of recent authors is kept for each topic, and hashtag
+     follows favour topics that are currently trending. */
 
     HashTags hashtags;
-    std::vector<double> updating_follow_probabilities;
 
     /* InteractiveModeState: 
      State for determining when to begin interactive mode. See above. */
@@ -197,6 +293,11 @@ struct AnalysisState {
         follow_ranks = config.follow_ranks;
         retweet_ranks = config.retweet_ranks;
         agent_types = config.agent_types;
+        preferential_sampler.set_exponent(config.barabasi_exponent);
+        alias_tables.build(this->config);
+        hashtags.configure(config.hashtag_topics, config.hashtag_trend_halflife);
+        follow_kernel = analyzer_follow_kernel(config);
+        network.set_follower_dims(follower_set_dims(config));
         // Fill callbacks with NULL
         memset(&event_callbacks, 0, sizeof(EventCallbacks));
 
@@ -225,30 +326,82 @@ struct AnalysisState {
         for (int i = 0; i < agent_types.size(); i++) {
             agent_types[i].sync_configuration(config.agent_types[i]);
         }
+        alias_tables.build(config);
+        hashtags.configure(config.hashtag_topics, config.hashtag_trend_halflife);
+        follow_kernel = analyzer_follow_kernel(config);
+        if (config.use_barabasi) {
+            rebuild_preferential_sampler();
+        }
+    }
+
+    void rebuild_preferential_sampler() {
+        preferential_sampler.clear();
+        preferential_sampler.set_exponent(config.barabasi_exponent);
+        for (Agent& agent : network) {
+            preferential_sampler.add_agent(agent.follower_set().size());
+        }
     }
 
     // For network reading/writing:
     template <typename Archive>
     void serialize(Archive& ar) {
         ar(NVP(network));
-        ar(NVP(time));
+        serialize_without_network(ar);
+    }
+
+    // The parts of the state besides the network. Snapshots store each in its own
+    // section, so that checkpoints can leave out the parts that did not change (see analyzer_snapshot.cpp).
+    enum StatePart {
+        STATE_TIME,
+        STATE_RANKS,
+        STATE_TWEETS, // The tweet bank and old tweets share their content, so they are one part
+        STATE_STATS,
+        STATE_HASHTAGS,
+        STATE_RUN, // Agent types, counters and the RNG
+        N_STATE_PARTS
+    };
+
+    template <typename Archive>
+    void serialize_state_part(Archive& ar, StatePart part) {
+        switch (part) {
+        case STATE_TIME:
+            ar(NVP(time));
+            break;
+        case STATE_RANKS:
+            ar(NVP(tweet_ranks));
+            ar(NVP(follow_ranks));
+            ar(NVP(retweet_ranks));
+            break;
+        case STATE_TWEETS:
+            ar(NVP(tweet_bank));
+            ar(NVP(old_tweets));
+            break;
+        case STATE_STATS:
+            ar(NVP(stats));
+            break;
+        case STATE_HASHTAGS:
+            ar(NVP(hashtags));
+            break;
+        case STATE_RUN:
+            ar(NVP(agent_types));
+            ar(NVP(n_follows), NVP(end_time));
+            // Don't serialize interactive_mode_state
+            ar(NVP(rng));
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Everything but the network, in order.
+    template <typename Archive>
+    void serialize_without_network(Archive& ar) {
         // Don't serialize config
         // Don't serialize event_callbacks
         // Don't serialize analyzer
-
-        ar(NVP(tweet_ranks));
-        ar(NVP(follow_ranks));
-        ar(NVP(retweet_ranks));
-        ar(NVP(tweet_bank));
-        ar(NVP(old_tweets));
-        ar(NVP(stats));
-        ar(NVP(hashtags));
-        ar(NVP(agent_types));
-
-        ar(NVP(n_follows), NVP(end_time));
-        ar(NVP(updating_follow_probabilities));
-        // Don't serialize interactive_mode_state
-        ar(NVP(rng));
+        for (int part = 0; part < N_STATE_PARTS; part++) {
+            serialize_state_part(ar, (StatePart)part);
+        }
     }
 };
 
@@ -292,6 +445,21 @@ bool analyzer_sim_time_check(AnalysisState& state);
 bool analyzer_real_time_check(AnalysisState& state);
 void analyzer_save_network_state(AnalysisState& state, const char* fname);
 void analyzer_load_network_state(AnalysisState& state, const char* fname);
+// Exits with an error if 'saved_config_file' does not match the running config (unless the check is disabled)
+void analyzer_check_saved_config(AnalysisState& state, const std::string& saved_config_file);
+// Columnar, memory-mappable save files, used for file names ending in '.snap'. See analyzer_snapshot.cpp.
+void analyzer_save_snapshot(AnalysisState& state, const char* fname);
+void analyzer_load_snapshot(AnalysisState& state, const char* fname);
+// Write a checkpoint to 'fname': a full snapshot the first time, then deltas on top of it. See CheckpointLog.h.
+void analyzer_checkpoint(AnalysisState& state, const char* fname);
+// False while the background checkpoints being written rule out starting another (see output.checkpoint_max_forks).
+bool analyzer_background_checkpoint_ready(AnalysisState& state);
+// As analyzer_checkpoint, but written by a forked child while the simulation goes on.
+void analyzer_checkpoint_in_background(AnalysisState& state, const char* fname);
+// Reap the finished background checkpoints and report on them; with 'wait', wait for all of them.
+void analyzer_poll_background_checkpoints(AnalysisState& state, bool wait);
+// Fold the checkpoint deltas of snapshot 'fname' into a new snapshot in its place.
+void analyzer_compact_checkpoints(AnalysisState& state, const char* fname);
 bool analyzer_follow_agent(AnalysisState& state, int agent, double time_of_follow);
 
 // Implements a follow-back
@@ -310,9 +478,27 @@ void spawn_stdin_command_queueing_thread_for_api();
 
 // this is for the retweet agent selection
 RetweetChoice analyzer_select_tweet_to_retweet(AnalysisState& state);
+// Leave the tweeter's followers that already reacted to a retweet's content out of its react_weight
+void analyzer_exclude_past_reactors(AnalysisState& state, Tweet& tweet);
+// Count a new follower of a tweeter among the exclusions of the tweeter's active tweets it already reacted to
+void analyzer_exclude_new_follower(AnalysisState& state, int id_followed, int id_follower);
+// Drop an agent that unfollowed a tweeter from the exclusions of the tweeter's active tweets
+void analyzer_forget_excluded_follower(AnalysisState& state, int id_unfollowed, int id_lost_follower);
 
 // Create an agent
 bool analyzer_create_agent(AnalysisState& state);
+// Draw a new agent's region, ideology, language, preference class and agent type
+void analyzer_pick_agent_attributes(AnalysisState& state, Agent& e, MTwist& rng);
+
+// Bulk-create the initial agents, and their Barabasi follows, in parallel.
+// Only supported for configurations without per-follow side effects, see analyzer_bulk.cpp.
+bool analyzer_can_bulk_create_agents(AnalysisState& state);
+void analyzer_bulk_create_agents(AnalysisState& state, int n_agents);
+// Start from the follow graph given by analysis.initial_graph, instead of 'initial_agents'.
+void analyzer_load_initial_graph(AnalysisState& state);
+
+// Measure the memory held by each subsystem of the simulation
+MemoryUsage analyzer_memory_usage(AnalysisState& state);
 
 void update_retweets(AnalysisState& state);
 
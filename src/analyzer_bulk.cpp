@@ -0,0 +1,506 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "analyzer.h"
+#include "util/ParallelFor.h"
+#include "util/MappedFile.h"
+
+using namespace std;
+
+/* Bulk construction of the initial network (analysis.use_bulk_initial_agents).
+ *
+ * Instead of creating agents one at a time, each with 'barabasi_connections'
+ * calls to follow_agent, we:
+ *  1. Draw every agent's attributes in parallel.
+ *  2. Generate each agent's follow targets into an edge list; in parallel for
+ *     the 'random' follow model, in one sequential pass over the exact
+ *     preferential sampler for 'twitter_suggest' (each draw depends on the
+ *     degrees before it).
+ *  3. Insert the edges in parallel, partitioned by follower for the
+ *     following sets, and by followed agent for the follower sets.
+ *  4. Categorize each agent once, at its final degree.
+ *
+ * Random numbers come from one stream per chunk of CHUNK_SIZE agents, seeded
+ * from the main generator, so the network built depends only on the seed.
+ * The result is a different (but equally distributed) network from the one
+ * sequential creation gives for the same seed. */
+struct AnalyzerBulk {
+    //** Note: Only use reference types here!!
+    AnalysisState& state;
+    ParsedConfig& config;
+    Network& network;
+    AgentTypeVector& agent_types;
+    MTwist& rng;
+
+    // Agents per random stream, and per parallel task.
+    static const int CHUNK_SIZE = 4096;
+
+    AnalyzerBulk(AnalysisState& state) :
+            state(state), config(state.config), network(state.network),
+            agent_types(state.agent_types), rng(state.rng) {
+    }
+
+    // Small open-addressing set, to find repeated targets among one agent's follows.
+    struct TargetSet {
+        std::vector<int> slots;
+        unsigned int mask = 0;
+
+        void reset(int n) {
+            int size = 2;
+            while (size < 2 * n) {
+                size *= 2;
+            }
+            slots.assign(size, -1);
+            mask = size - 1;
+        }
+        bool insert(int id) {
+            unsigned int h = ((unsigned int)id * 2654435761u) & mask;
+            while (slots[h] != -1) {
+                if (slots[h] == id) {
+                    return false;
+                }
+                h = (h + 1) & mask;
+            }
+            slots[h] = id;
+            return true;
+        }
+    };
+
+    // Follows, as compressed rows: the targets of agent 'first + i' are
+    // targets[offsets[i]] up to targets[offsets[i+1]].
+    struct EdgeRows {
+        std::vector<size_t> offsets;
+        std::vector<int> targets;
+    };
+
+    bool supported() {
+        // Hooks expect to see each agent and follow as it happens:
+        if (config.enable_lua_hooks || state.event_callbacks.on_add || state.event_callbacks.on_follow) {
+            return false;
+        }
+        if (!config.use_barabasi) {
+            return true;
+        }
+        // Unfollows and followbacks depend on the network as it grows:
+        if (config.stage1_unfollow || config.use_followback) {
+            return false;
+        }
+        return config.follow_model == RANDOM_FOLLOW || config.follow_model == TWITTER_PREFERENTIAL_FOLLOW;
+    }
+
+    static void seed_chunk_rng(MTwist& chunk_rng, unsigned int seed, int chunk) {
+        unsigned int key[2] = {seed, (unsigned int)chunk};
+        chunk_rng.init_by_array(key, 2);
+    }
+
+    static int n_chunks(int first, int end) {
+        return (end - first + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    void create_agents(int n_agents) {
+        PERF_TIMER();
+        int first = network.size();
+        int end = first + std::min(n_agents, network.max_size() - first);
+        unsigned int seed = rng.genrand_int32();
+        add_agents(end, seed, AttributeColumns());
+
+        if (config.use_barabasi) {
+            EdgeRows rows;
+            if (config.follow_model == RANDOM_FOLLOW) {
+                random_follows(first, end, seed, rows);
+            } else {
+                preferential_follows(first, end, seed, rows);
+            }
+            insert_follows(first, end, rows, config.follow_model);
+        }
+        finish(end, config.use_barabasi && config.follow_model == RANDOM_FOLLOW);
+    }
+
+    // Per-agent attribute columns of an imported graph; NULL where not given.
+    struct AttributeColumns {
+        const int* agent_types = NULL;
+        const int* regions = NULL;
+        const int* languages = NULL;
+        const int* ideologies = NULL;
+    };
+
+    void pick_attributes(Agent& e, MTwist& agent_rng, const AttributeColumns& columns) {
+        if (!columns.agent_types && !columns.regions && !columns.languages && !columns.ideologies) {
+            analyzer_pick_agent_attributes(state, e, agent_rng);
+            return;
+        }
+        // As in analyzer_pick_agent_attributes, with given columns taking the place of draws:
+        ConfigAliasTables& tables = state.alias_tables;
+        int region_bin = columns.regions ? columns.regions[e.id] : tables.region_add.pick(agent_rng);
+        e.region_bin = region_bin;
+        e.ideology_bin = columns.ideologies ? columns.ideologies[e.id] : tables.region_ideology[region_bin].pick(agent_rng);
+        e.language = (Language) (columns.languages ? columns.languages[e.id] : tables.region_language[region_bin].pick(agent_rng));
+        e.details().ideology_tweet_percent = agent_rng.random_chance(0.5) ? 1.0 : 0.0;
+        e.preference_class = tables.region_preference_class[region_bin].pick(agent_rng);
+        e.agent_type = columns.agent_types ? columns.agent_types[e.id] : tables.agent_type_add.pick(agent_rng);
+    }
+
+    // Grow the network up to 'end' agents, drawing their attributes in parallel.
+    void add_agents(int end, unsigned int seed, const AttributeColumns& columns) {
+        PERF_TIMER();
+        ASSERT(config.regions.regions.size() <= N_BIN_REGIONS, "Too many regions!");
+        int first = network.size();
+        for (int id = first; id < end; id++) {
+            network.grow();
+            Agent& e = network[id];
+            e.id = id;
+            e.creation_time = state.time;
+        }
+        parallel_for(n_chunks(first, end), [&](int chunk) {
+            MTwist chunk_rng;
+            seed_chunk_rng(chunk_rng, seed, chunk);
+            int chunk_end = std::min(end, first + (chunk + 1) * CHUNK_SIZE);
+            for (int id = first + chunk * CHUNK_SIZE; id < chunk_end; id++) {
+                pick_attributes(network[id], chunk_rng, columns);
+            }
+        });
+        for (int id = first; id < end; id++) {
+            agent_types[network[id].agent_type].agents.agent_ids.push_back(id);
+        }
+    }
+
+    // Categorize once, at the final degree. Earlier agents may have gained followers too.
+    void finish(int end, bool rebuild_sampler) {
+        PERF_TIMER();
+        for (int id = 0; id < end; id++) {
+            Agent& e = network[id];
+            follow_ranks_categorize(id, e.follower_set().size());
+        }
+        if (rebuild_sampler) {
+            state.rebuild_preferential_sampler();
+        }
+    }
+
+    /* Import an existing follow graph as the initial network, see InitialGraphFiles. */
+    void load_graph(const InitialGraphFiles& files) {
+        PERF_TIMER();
+        ASSERT(network.size() == 0, "The initial graph must be loaded into an empty network!");
+        MappedFile edge_file, type_file, region_file, language_file, ideology_file;
+        map_input(edge_file, files.edges);
+        if (edge_file.size() % (2 * sizeof(int)) != 0) {
+            error_exit("initial_graph: '" + files.edges + "' is not a whole number of (follower, followed) int32 pairs!");
+        }
+        const int* edges = edge_file.data<int>();
+        size_t n_edges = edge_file.count<int>() / 2;
+
+        // The agent count comes from the columns if given, otherwise from the largest id:
+        int n_agents = -1;
+        AttributeColumns columns;
+        columns.agent_types = map_column(type_file, files.agent_types, n_agents);
+        columns.regions = map_column(region_file, files.regions, n_agents);
+        columns.languages = map_column(language_file, files.languages, n_agents);
+        columns.ideologies = map_column(ideology_file, files.ideologies, n_agents);
+        int max_id = -1;
+        for (size_t i = 0; i < 2 * n_edges; i++) {
+            if (edges[i] < 0) {
+                error_exit("initial_graph: negative agent id in '" + files.edges + "'!");
+            }
+            max_id = std::max(max_id, edges[i]);
+        }
+        if (n_agents == -1) {
+            n_agents = max_id + 1;
+        } else if (max_id >= n_agents) {
+            error_exit("initial_graph: edges refer to agents past the end of the attribute columns!");
+        }
+        if (n_agents > network.max_size()) {
+            error_exit(format("initial_graph: %d agents, but max_agents is %d!", n_agents, network.max_size()));
+        }
+        check_column(columns.agent_types, n_agents, agent_types.size(), "agent_types");
+        check_column(columns.regions, n_agents, config.regions.size(), "regions");
+        check_column(columns.languages, n_agents, N_LANGS, "languages");
+        check_column(columns.ideologies, n_agents, config.ideologies.size(), "ideologies");
+
+        add_agents(n_agents, rng.genrand_int32(), columns);
+        EdgeRows rows;
+        size_t n_dropped = graph_rows(edges, n_edges, n_agents, rows);
+        // Imported follows were not made by any of our follow models:
+        insert_follows(0, n_agents, rows, -1);
+        finish(n_agents, config.use_barabasi);
+
+        cout << "Loaded initial graph: " << n_agents << " agents, " << rows.targets.size() << " follows";
+        if (n_dropped > 0) {
+            cout << " (" << n_dropped << " repeated or self follows dropped)";
+        }
+        cout << ".\n";
+    }
+
+    static void map_input(MappedFile& file, const std::string& fname) {
+        if (!file.open(fname)) {
+            error_exit("initial_graph: could not open '" + fname + "'!");
+        }
+    }
+
+    // Map an optional int32 column, checking that every column has the same length.
+    static const int* map_column(MappedFile& file, const std::string& fname, int& n_agents) {
+        if (fname.empty()) {
+            return NULL;
+        }
+        map_input(file, fname);
+        int n = file.count<int>();
+        if (n_agents != -1 && n != n_agents) {
+            error_exit("initial_graph: attribute columns differ in length ('" + fname + "')!");
+        }
+        n_agents = n;
+        return file.data<int>();
+    }
+
+    static void check_column(const int* column, int n_agents, int n_values, const char* name) {
+        if (column == NULL) {
+            return;
+        }
+        for (int id = 0; id < n_agents; id++) {
+            if (column[id] < 0 || column[id] >= n_values) {
+                error_exit(format("initial_graph: %s[%d] is %d, but must be in [0, %d)!", name, id, column[id], n_values));
+            }
+        }
+    }
+
+    // Group the edge list by follower, dropping self-follows and repeats.
+    // Returns the number of edges dropped.
+    size_t graph_rows(const int* edges, size_t n_edges, int n_agents, EdgeRows& rows) {
+        PERF_TIMER();
+        rows.offsets.assign(n_agents + 1, 0);
+        for (size_t i = 0; i < n_edges; i++) {
+            rows.offsets[edges[2 * i] + 1]++;
+        }
+        for (int id = 0; id < n_agents; id++) {
+            rows.offsets[id + 1] += rows.offsets[id];
+        }
+        rows.targets.resize(n_edges);
+        {
+            std::vector<size_t> fill(rows.offsets.begin(), rows.offsets.end() - 1);
+            for (size_t i = 0; i < n_edges; i++) {
+                rows.targets[fill[edges[2 * i]]++] = edges[2 * i + 1];
+            }
+        }
+        // Clean each row in place, in parallel:
+        std::vector<int> counts(n_agents);
+        parallel_for(n_chunks(0, n_agents), [&](int chunk) {
+            int chunk_end = std::min(n_agents, (chunk + 1) * CHUNK_SIZE);
+            for (int id = chunk * CHUNK_SIZE; id < chunk_end; id++) {
+                int* begin = &rows.targets[0] + rows.offsets[id];
+                int* end = &rows.targets[0] + rows.offsets[id + 1];
+                std::sort(begin, end);
+                end = std::unique(begin, end);
+                end = std::remove(begin, end, id);
+                counts[id] = end - begin;
+            }
+        });
+        // ... then compact the rows. Rows only shrink, so moving them down is safe:
+        size_t n_kept = 0;
+        for (int id = 0; id < n_agents; id++) {
+            size_t begin = rows.offsets[id];
+            rows.offsets[id] = n_kept;
+            for (int i = 0; i < counts[id]; i++) {
+                rows.targets[n_kept++] = rows.targets[begin + i];
+            }
+        }
+        rows.offsets[n_agents] = n_kept;
+        rows.targets.resize(n_kept);
+        return n_edges - n_kept;
+    }
+
+    void follow_ranks_categorize(int id, int n_followers) {
+        agent_types[network[id].agent_type].follow_ranks.categorize(id, n_followers);
+        state.follow_ranks.categorize(id, n_followers);
+    }
+
+    bool can_follow(Agent& e, int id_target) {
+        return id_target != e.id && language_understandable(e.language, network[id_target].language);
+    }
+
+    // As if agent 'id' had tried 'barabasi_connections' random follows upon creation,
+    // among the agents [0, id].
+    void random_follows(int first, int end, unsigned int seed, EdgeRows& rows) {
+        PERF_TIMER();
+        int k = config.barabasi_connections;
+        std::vector<int> counts(end - first, 0);
+        std::vector<std::vector<int>> chunk_targets(n_chunks(first, end));
+        parallel_for(chunk_targets.size(), [&](int chunk) {
+            MTwist chunk_rng;
+            // Distinct streams from the attribute streams:
+            seed_chunk_rng(chunk_rng, ~seed, chunk);
+            TargetSet followed;
+            std::vector<int>& out = chunk_targets[chunk];
+            int chunk_end = std::min(end, first + (chunk + 1) * CHUNK_SIZE);
+            for (int id = first + chunk * CHUNK_SIZE; id < chunk_end; id++) {
+                Agent& e = network[id];
+                followed.reset(k);
+                for (int j = 0; j < k; j++) {
+                    int id_target = chunk_rng.rand_int(id + 1);
+                    if (can_follow(e, id_target) && followed.insert(id_target)) {
+                        out.push_back(id_target);
+                        counts[id - first]++;
+                    }
+                }
+            }
+        });
+        for (int id = first; id < end; id++) {
+            int et = network[id].agent_type;
+            agent_types[et].stats.n_random_follows += k;
+            state.stats.global_stats.n_random_follows += k;
+        }
+        build_rows(counts, chunk_targets, rows);
+    }
+
+    // As if agent 'id' had made 'barabasi_connections' exact preferential follows upon creation.
+    void preferential_follows(int first, int end, unsigned int seed, EdgeRows& rows) {
+        PERF_TIMER();
+        int k = config.barabasi_connections;
+        PreferentialSampler& sampler = state.preferential_sampler;
+        MTwist pref_rng;
+        seed_chunk_rng(pref_rng, ~seed, -1);
+
+        // Followers gained so far during the bulk build:
+        std::vector<int> new_followers(end, 0);
+        std::vector<int> counts(end - first, 0);
+        std::vector<std::vector<int>> chunk_targets(1);
+        std::vector<int>& out = chunk_targets[0];
+        TargetSet followed;
+        for (int id = first; id < end; id++) {
+            Agent& e = network[id];
+            sampler.add_agent(e.follower_set().size());
+            DEBUG_CHECK(sampler.size() == id + 1, "Preferential sampler out of sync with network!");
+            followed.reset(k);
+            for (int j = 0; j < k; j++) {
+                int id_target = sampler.pick(pref_rng.rand_real_not0());
+                if (id_target != -1 && can_follow(e, id_target) && followed.insert(id_target)) {
+                    out.push_back(id_target);
+                    counts[id - first]++;
+                    int degree = network[id_target].follower_set().size() + (++new_followers[id_target]);
+                    sampler.set_degree(id_target, degree);
+                }
+            }
+        }
+        build_rows(counts, chunk_targets, rows);
+    }
+
+    // Chunks were filled in agent order, so concatenating them lines up with 'counts'.
+    static void build_rows(const std::vector<int>& counts, std::vector<std::vector<int>>& chunk_targets, EdgeRows& rows) {
+        rows.offsets.assign(counts.size() + 1, 0);
+        for (int i = 0; i < counts.size(); i++) {
+            rows.offsets[i + 1] = rows.offsets[i] + counts[i];
+        }
+        rows.targets.reserve(rows.offsets.back());
+        for (std::vector<int>& targets : chunk_targets) {
+            rows.targets.insert(rows.targets.end(), targets.begin(), targets.end());
+            std::vector<int>().swap(targets);
+        }
+    }
+
+    // Insert the follows of agents [first, end), crediting them to 'method' if it is not -1.
+    void insert_follows(int first, int end, EdgeRows& rows, int method) {
+        PERF_TIMER();
+
+        // Followers of each agent in [0, end), in order of the following agent:
+        std::vector<size_t> in_offsets(end + 1, 0);
+        for (int target : rows.targets) {
+            in_offsets[target + 1]++;
+        }
+        for (int i = 0; i < end; i++) {
+            in_offsets[i + 1] += in_offsets[i];
+        }
+        std::vector<int> in_followers(rows.targets.size());
+        {
+            std::vector<size_t> fill(in_offsets.begin(), in_offsets.end() - 1);
+            for (int id = first; id < end; id++) {
+                for (size_t i = rows.offsets[id - first]; i < rows.offsets[id - first + 1]; i++) {
+                    in_followers[fill[rows.targets[i]]++] = id;
+                }
+            }
+        }
+
+        // Each task owns the following sets of its followers:
+        parallel_for(n_chunks(first, end), [&](int chunk) {
+            int chunk_end = std::min(end, first + (chunk + 1) * CHUNK_SIZE);
+            for (int id = first + chunk * CHUNK_SIZE; id < chunk_end; id++) {
+                Agent& e = network[id];
+                size_t begin = rows.offsets[id - first], row_end = rows.offsets[id - first + 1];
+                e.following_set().reserve(e.following_set().size() + (row_end - begin));
+                for (size_t i = begin; i < row_end; i++) {
+                    bool was_added = e.following_set().add(state, rows.targets[i]);
+                    DEBUG_CHECK(was_added, "Repeated follow in bulk edge list!");
+                }
+                if (method != -1) {
+                    e.details().follower_method_counts[method] += (row_end - begin);
+                }
+            }
+        });
+        // ... and of the follower sets of its followed agents:
+        parallel_for(n_chunks(0, end), [&](int chunk) {
+            int chunk_end = std::min(end, (chunk + 1) * CHUNK_SIZE);
+            std::vector<Agent*> followers;
+            for (int id = chunk * CHUNK_SIZE; id < chunk_end; id++) {
+                Agent& target = network[id];
+                // Presized per leaf, rather than grown one follower at a time:
+                followers.clear();
+                for (size_t i = in_offsets[id]; i < in_offsets[id + 1]; i++) {
+                    followers.push_back(&network[in_followers[i]]);
+                }
+                size_t n_added = target.follower_set().add_all(followers);
+                DEBUG_CHECK(n_added == followers.size(), "Follow/follower-set asymmetry detected!");
+                if (method != -1) {
+                    target.details().following_method_counts[method] += (in_offsets[id + 1] - in_offsets[id]);
+                }
+            }
+        });
+
+        for (int id = first; id < end; id++) {
+            int n = rows.offsets[id - first + 1] - rows.offsets[id - first];
+            agent_types[network[id].agent_type].stats.n_follows += n;
+            state.stats.global_stats.n_follows += n;
+        }
+        for (int id = 0; id < end; id++) {
+            int n = in_offsets[id + 1] - in_offsets[id];
+            agent_types[network[id].agent_type].stats.n_followers += n;
+            state.stats.global_stats.n_followers += n;
+        }
+    }
+};
+
+bool analyzer_can_bulk_create_agents(AnalysisState& state) {
+    AnalyzerBulk analyzer(state);
+    return analyzer.supported();
+}
+
+void analyzer_bulk_create_agents(AnalysisState& state, int n_agents) {
+    PERF_TIMER();
+    AnalyzerBulk analyzer(state);
+    analyzer.create_agents(n_agents);
+}
+
+void analyzer_load_initial_graph(AnalysisState& state) {
+    PERF_TIMER();
+    AnalyzerBulk analyzer(state);
+    analyzer.load_graph(state.config.initial_graph);
+}
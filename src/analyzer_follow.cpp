@@ -40,8 +40,6 @@ struct AnalyzerFollow {
     AnalysisState& state;
     NetworkStats& stats;
     CategoryGrouper& follow_ranks;
-    vector<double>& follow_probabilities;
-    vector<double>& updating_follow_probabilities;
 
     AgentTypeVector& agent_types;
     MTwist& rng;
@@ -50,8 +48,6 @@ struct AnalyzerFollow {
     AnalyzerFollow(AnalysisState& state) :
             network(state.network), state(state), stats(state.stats),
             config(state.config), follow_ranks(state.follow_ranks),
-            follow_probabilities(state.config.follow_probabilities),
-            updating_follow_probabilities(state.updating_follow_probabilities),
             agent_types(state.agent_types), rng(state.rng), hashtags(state.hashtags) {
     }
 
@@ -60,34 +56,55 @@ struct AnalyzerFollow {
     ***************************************************************************/
  
     void flag_chatty_agent(Agent& actor, int id_target) {
-        actor.chatty_agents.push_back(id_target);
+        actor.details().chatty_agents.push_back(id_target);
     }
     
     void update_chatiness(Agent& actor, int id_target) {
        double targets_chatiness = agent_types[network[id_target].agent_type].RF[1].const_val;
        // arbitrary factor greater than the average chatiness
-       actor.avg_chatiness = (actor.avg_chatiness*(actor.following_set.size() - 1) + targets_chatiness) / (double) actor.following_set.size();       
-       if (actor.avg_chatiness*2 < targets_chatiness && actor.following_set.size() != 0) {
+       actor.details().avg_chatiness = (actor.details().avg_chatiness*(actor.following_set().size() - 1) + targets_chatiness) / (double) actor.following_set().size();       
+       if (actor.details().avg_chatiness*2 < targets_chatiness && actor.following_set().size() != 0) {
            flag_chatty_agent(actor, id_target);
            // reset the average chattiness
-           actor.avg_chatiness = (actor.avg_chatiness*(actor.following_set.size() - 1) + targets_chatiness) / (double) actor.following_set.size();
+           actor.details().avg_chatiness = (actor.details().avg_chatiness*(actor.following_set().size() - 1) + targets_chatiness) / (double) actor.following_set().size();
        }
     }
     // Returns true if a follow is added that was not already added
+   bool handle_follow(int id_actor, int id_target, int follow_method) {
+       if (config.use_barabasi) {
+           return handle_follow<true, true>(id_actor, id_target, follow_method);
+       }
+       return handle_follow<false, true>(id_actor, id_target, follow_method);
+   }
+
+   // Specialized on use_barabasi, and on whether stage1_unfollow or use_followback may be set (SIDE_EFFECTS).
+   template <bool BARABASI, bool SIDE_EFFECTS>
    bool handle_follow(int id_actor, int id_target, int follow_method) {
        DEBUG_CHECK(follow_method >= 0 && follow_method < N_FOLLOW_MODELS,
            "Follow method must be a known method other than the compound Twitter model");
        PERF_TIMER();
        Agent& A = network[id_actor];
        Agent& T = network[id_target];
-       bool was_added = A.following_set.add(state, id_target);
+       bool was_added = A.following_set().add(state, id_target);
        // if the follow is possible
        if (was_added) {
-           bool was_added = T.follower_set.add(network[id_actor]);
-           A.follower_method_counts[follow_method]++;
-           T.following_method_counts[follow_method]++;
+           // Each side is counted as it changes, which holds for an agent following itself too:
+           if (state.degree_histograms.enabled) {
+               state.degree_histograms.changed(A, +1, 0);
+           }
+           bool was_added = T.follower_set().add(network[id_actor]);
+           if (state.degree_histograms.enabled) {
+               state.degree_histograms.changed(T, 0, +1);
+           }
+           if (BARABASI) {
+               state.preferential_sampler.set_degree(id_target, T.follower_set().size());
+           }
+           analyzer_exclude_new_follower(state, id_target, id_actor);
+           A.details().follower_method_counts[follow_method]++;
+           T.details().following_method_counts[follow_method]++;
            ASSERT(was_added, "Follow/follower-set asymmetry detected!");
-           if (config.stage1_unfollow) {
+           state.checkpoints.log_edge(id_actor, id_target, CheckpointLog::FOLLOW);
+           if (SIDE_EFFECTS && config.stage1_unfollow) {
                update_chatiness(A, id_target);
            }
            lua_hook_follow(state, id_actor, id_target);
@@ -107,69 +124,29 @@ struct AnalyzerFollow {
        return rng.rand_int(n_agents);
    }
    
+   // The normalized weight of a follow_ranks category, chosen by weight.
    double preferential_weight() {
-       double rand_num = rng.rand_real_not0();
-       double prob_sum = 0;
-       auto& updating_probs = updating_follow_probabilities;
-       
-       updating_probs.resize(follow_ranks.categories.size());
-       for (int i = 0; i < follow_ranks.categories.size(); i ++) {
-           CategoryAgentList& C = follow_ranks.categories[i];
-           updating_probs[i] = follow_ranks.categories[i].prob * C.agents.size();
-           prob_sum += follow_ranks.categories[i].prob * C.agents.size();
+       int i = follow_ranks.pick_weighted(rng.rand_real_not0());
+       if (i == -1) {
+           return 0;
        }
-       for (auto& p : updating_probs) {
-           p /= prob_sum;
-       }
-       int i = 0;
-       double val = 0;
-       for (auto& p : updating_probs) {
-           if (rand_num <= p) {
-               val = p;
-               break;
-           }
-           rand_num -= p;
-           i++;
+       return follow_ranks.category_weight(i) / follow_ranks.total_weight();
+   }
+
+   // Pull a random agent from a follow_ranks category, chosen by weight.
+   int preferential_pick(CategoryGrouper& ranks, double rand_num) {
+       int i = ranks.pick_weighted(rand_num);
+       if (i == -1) {
+           return -1;
        }
-       return val;
+       CategoryAgentList& C = ranks.categories[i];
+       return C.agents[rng.rand_int(C.agents.size())];
    }
 
+   // Exact preferential attachment, each agent weighted by (in-degree + 1)^barabasi_exponent.
    int preferential_barabasi_follow_method() {
        PERF_TIMER();
-
-       double rand_num = rng.rand_real_not0();
-       // if we want to use a preferential follow method
-       int agent_to_follow = -1;
-       double sum_of_weights = 0;
-       updating_follow_probabilities.resize(follow_probabilities.size());
-       /* search through the probabilities for each threshold and find
-       the right bin to land in */
-
-       for (int i = 0; i < follow_probabilities.size(); i++){
-           // look at each category
-           CategoryAgentList& C = follow_ranks.categories[i];
-           updating_follow_probabilities[i] = follow_probabilities[i] * C.agents.size();
-           sum_of_weights += C.agents.size()*follow_probabilities[i];
-       }
-       for (int i = 0; i < follow_probabilities.size(); i++){
-           updating_follow_probabilities[i] /= sum_of_weights;
-       }
-
-       for (int i = 0; i < updating_follow_probabilities.size(); i++) {
-           if (rand_num <= updating_follow_probabilities[i]) {
-               // point to the category we landed in
-               CategoryAgentList& C = follow_ranks.categories[i];
-               // make sure we're not pulling a agent from an empty list
-               if (C.agents.size() != 0) {
-                   // pull a random agent from whatever bin we landed in and break so we do not continue this loop
-                   agent_to_follow = C.agents[rng.rand_int(C.agents.size())];
-                   return agent_to_follow;
-               }
-           }
-           // part of the above search
-           rand_num -= updating_follow_probabilities[i];
-       }
-       return -1;
+       return state.preferential_sampler.pick(rng.rand_real_not0());
    }
 
    int twitter_preferential_follow_method(Agent& e, double time_of_follow) {
@@ -180,32 +157,7 @@ struct AnalyzerFollow {
        if (!rng.random_chance(follow_prob)) {
            return -1;
        }
-       
-       double rand_num = rng.rand_real_not0();
-       double prob_sum = 0;
-       auto& updating_probs = updating_follow_probabilities;
-       
-       updating_probs.resize(follow_ranks.categories.size());
-       for (int i = 0; i < follow_ranks.categories.size(); i ++) {
-           CategoryAgentList& C = follow_ranks.categories[i];
-           updating_probs[i] = follow_ranks.categories[i].prob * C.agents.size();
-           prob_sum += follow_ranks.categories[i].prob * C.agents.size();
-       }
-       for (auto& p : updating_probs) {
-           p /= prob_sum;
-       }
-       int i = 0;
-       for (auto& p : updating_probs) {
-           if (rand_num <= p) {
-               CategoryAgentList& C = follow_ranks.categories[i];
-               // pull a random agent from whatever bin we landed in and break so we do not continue this loop
-               int agent_to_follow = C.agents[rng.rand_int(C.agents.size())];
-               return agent_to_follow;
-           }
-           rand_num -= p;
-           i++;
-       }
-       return -1;
+       return preferential_pick(follow_ranks, rng.rand_real_not0());
    }
 
    int agent_follow_method(Agent& e) {
@@ -243,28 +195,7 @@ struct AnalyzerFollow {
            if (rand_num <= agent_types[i].prob_follow) {
 
                double another_rand_num = rng.rand_real_not0();
-               // make sure we're not pulling from an empty list
-               AgentType& et = agent_types[i];
-               vector<double>& up = et.updating_probs;
-               up.resize(et.follow_ranks.categories.size());
-               double prob_sum = 0;
-               for (int j = 0; j < et.follow_ranks.categories.size(); j ++) {
-                   CategoryAgentList& C = et.follow_ranks.categories[j];
-                   up[j] = et.follow_ranks.categories[j].prob * C.agents.size();
-                   prob_sum += et.follow_ranks.categories[j].prob * C.agents.size();
-               }
-               for (int j = 0; j < up.size(); j ++) {                        
-                   up[j] /= prob_sum;
-               }
-               for (int j = 0; j < up.size(); j ++) {
-                   if (another_rand_num <= up[j]) {
-                       CategoryAgentList& C = et.follow_ranks.categories[j];
-                       // pull a random agent from whatever bin we landed in and break so we do not continue this loop                            
-                       agent_to_follow = C.agents[rng.rand_int(C.agents.size())];
-                       break;
-                   }
-                   another_rand_num -= up[j];
-               }
+               agent_to_follow = preferential_pick(agent_types[i].follow_ranks, another_rand_num);
            }
            if (agent_to_follow != -1){
                Agent& try_agent = network[agent_to_follow];
@@ -297,7 +228,7 @@ struct AnalyzerFollow {
    // 'model_chosen' is updated to the model randomly chosen according to a set of configured weights.
    int twitter_follow_model(Agent& e, double time_of_follow, /*Updated after call: */ FollowModel& model_chosen) {
        PERF_TIMER();
-       model_chosen = (FollowModel) rng.kmc_select(&config.model_weights[0], N_TWITTER_FOLLOW_MODELS);
+       model_chosen = (FollowModel) state.alias_tables.follow_model.pick(rng);
        if (model_chosen == RANDOM_FOLLOW) {
            return random_follow_method(e, network.size());
        } else if (model_chosen == TWITTER_PREFERENTIAL_FOLLOW) {
@@ -313,35 +244,41 @@ struct AnalyzerFollow {
        return -1;
     }
     
+   /* Dispatch to the appropriate follower logic, resolved at compile time.
+    * 'follow_model' is updated to the model used, for the compound twitter model. */
+   template <FollowModel MODEL, bool BARABASI>
+   int pick_agent_to_follow(Agent& e, double time_of_follow, FollowModel& follow_model) {
+       if (MODEL == RANDOM_FOLLOW) {
+           // find a random agent within [0:number of agents - 1]
+           return random_follow_method(e, network.size());
+       } else if (MODEL == TWITTER_PREFERENTIAL_FOLLOW && BARABASI) {
+           return preferential_barabasi_follow_method();
+       } else if (MODEL == TWITTER_PREFERENTIAL_FOLLOW) {
+           return twitter_preferential_follow_method(e, time_of_follow);
+       } else if (MODEL == AGENT_FOLLOW) {
+           return agent_follow_method(e);
+       } else if (MODEL == PREFERENTIAL_AGENT_FOLLOW) {
+           return preferential_agent_follow_method(e);
+       } else if (MODEL == TWITTER_FOLLOW) {
+           return twitter_follow_model(e, time_of_follow, /*Updated after call: */ follow_model);
+       } else if (MODEL == HASHTAG_FOLLOW) {
+           return hashtag_follow_method(e);
+       }
+       ASSERT(false, "Unknown follow model!");
+       return -1;
+   }
+
    // Returns false to signify that nothing occurred.
+   // Specialized on the follow model, use_barabasi, and on whether stage1_unfollow or use_followback may be set.
+    template <FollowModel MODEL, bool BARABASI, bool SIDE_EFFECTS>
     bool follow_agent(int id_follower, double time_of_follow) {
         Agent& e = network[id_follower];
-        int agent_to_follow = -1;
-
-        /* Dispatch to the appropriate follower logic: */
-        FollowModel follow_model = config.follow_model;
-        if (follow_model == RANDOM_FOLLOW) {
-            // find a random agent within [0:number of agents - 1]
-            agent_to_follow = random_follow_method(e, network.size());
-        } else if (follow_model == TWITTER_PREFERENTIAL_FOLLOW && config.use_barabasi) {
-            agent_to_follow = preferential_barabasi_follow_method();
-        } else if(follow_model == TWITTER_PREFERENTIAL_FOLLOW && !config.use_barabasi) {
-            agent_to_follow = twitter_preferential_follow_method(e, time_of_follow);
-        } else if (follow_model == AGENT_FOLLOW) {
-            agent_to_follow = agent_follow_method(e);
-        } else if (follow_model == PREFERENTIAL_AGENT_FOLLOW) {
-            agent_to_follow = preferential_agent_follow_method(e);
-        } else if (follow_model == TWITTER_FOLLOW) {
-            agent_to_follow = twitter_follow_model(e, time_of_follow, /*Updated after call: */ follow_model);
-        } else if (follow_model == HASHTAG_FOLLOW) {
-            agent_to_follow = hashtag_follow_method(e);
-        } else {
-            ASSERT(false, "Unknown follow model!");
-        }
+        FollowModel follow_model = MODEL;
+        int agent_to_follow = pick_agent_to_follow<MODEL, BARABASI>(e, time_of_follow, follow_model);
 
         // if the stage1_follow is set to true in the inputfile
-        if (config.stage1_unfollow) {
-            vector<int>& chatties = e.chatty_agents;
+        if (SIDE_EFFECTS && config.stage1_unfollow) {
+            vector<int>& chatties = e.details().chatty_agents;
             if (chatties.size() > 0) {
                 int id_agent_unfollowed = rng.pick_random_uniform(chatties);
                 // Will remove from chattiness list after unfollow:
@@ -360,7 +297,7 @@ struct AnalyzerFollow {
         if (LIKELY(!same_agent && same_language)) {
             perf_timer_begin("AnalyzerFollower.follow_agent(handle_follow)");
             // point to the agent who is being followed
-            if (handle_follow(id_follower, agent_to_follow, follow_model)) {
+            if (handle_follow<BARABASI, SIDE_EFFECTS>(id_follower, agent_to_follow, follow_model)) {
                 /* FEATURE: Follow-back based on target's prob_followback.
                  * Set in INFILE.yaml as followback_probability. */
                 int et_id = network[agent_to_follow].agent_type;
@@ -369,14 +306,14 @@ struct AnalyzerFollow {
                 // TODO this followback process has to be another follow method that happens naturally at some other time, possibly another 'spike' in the rate
                 // TODO AD -- I think we can just queue an event, at some time frame in the future, and activate it
                 // when KMC crosses that time.
-                if (config.use_followback && rng.random_chance(et.prob_followback)) {
+                if (SIDE_EFFECTS && config.use_followback && rng.random_chance(et.prob_followback)) {
                     analyzer_followback(state, id_follower, agent_to_follow);
                 }
                 // based on the number of followers the followed-agent has, check to make sure we're still categorized properly
                 Agent& target = network[agent_to_follow];
                 // We were able to add the follow:
-                et.follow_ranks.categorize(agent_to_follow, target.follower_set.size());
-                follow_ranks.categorize(agent_to_follow, target.follower_set.size());
+                et.follow_ranks.categorize(agent_to_follow, target.follower_set().size());
+                follow_ranks.categorize(agent_to_follow, target.follower_set().size());
 
                 return true;
             }
@@ -393,8 +330,8 @@ struct AnalyzerFollow {
         if (handle_follow(prev_target_id, prev_actor_id, FOLLOW_BACK_FOLLOW)) {
             int et_id = network[prev_actor_id].agent_type;
             AgentType& et = agent_types[et_id];
-            et.follow_ranks.categorize(prev_actor_id, prev_actor.follower_set.size());
-            follow_ranks.categorize(prev_actor_id, prev_actor.follower_set.size());
+            et.follow_ranks.categorize(prev_actor_id, prev_actor.follower_set().size());
+            follow_ranks.categorize(prev_actor_id, prev_actor.follower_set().size());
             RECORD_STAT(state, prev_target.agent_type, n_followback);
             return true;
         }
@@ -404,7 +341,7 @@ struct AnalyzerFollow {
     }
 
     void remove_chatty_agent(Agent& unfollowed, Agent& lost_follower) {
-        auto& c = lost_follower.chatty_agents;
+        auto& c = lost_follower.details().chatty_agents;
         auto iter = std::find(c.begin(), c.end(), unfollowed.id);
         bool in_chatty_agents_list = (iter != c.end());
         if (in_chatty_agents_list) {
@@ -419,12 +356,23 @@ struct AnalyzerFollow {
         Agent& unfollowed = network[id_unfollowed], &lost_follower = network[id_lost_follower];
 
         // Remove the lost follower from the unfollowed's follows:
-        bool had_follower = unfollowed.follower_set.remove(lost_follower);
+        bool had_follower = unfollowed.follower_set().remove(lost_follower);
         DEBUG_CHECK(had_follower, "unfollow: Did not exist in follower list");
+        if (state.degree_histograms.enabled) {
+            state.degree_histograms.changed(unfollowed, 0, -1);
+        }
+        if (config.use_barabasi) {
+            state.preferential_sampler.set_degree(id_unfollowed, unfollowed.follower_set().size());
+        }
 
         // Remove the lost follower from the unfollowed's followers:
-        bool had_follow = lost_follower.following_set.remove(state, id_unfollowed);
+        bool had_follow = lost_follower.following_set().remove(state, id_unfollowed);
         DEBUG_CHECK(had_follow, "unfollow: Did not exist in follow list");
+        if (state.degree_histograms.enabled) {
+            state.degree_histograms.changed(lost_follower, -1, 0);
+        }
+        state.checkpoints.log_edge(id_lost_follower, id_unfollowed, CheckpointLog::UNFOLLOW);
+        analyzer_forget_excluded_follower(state, id_unfollowed, id_lost_follower);
 
         // Remove the unfollowed person from our target's chattiness list, if found there:
         remove_chatty_agent(unfollowed, lost_follower);
@@ -452,9 +400,43 @@ bool analyzer_handle_unfollow(AnalysisState& state, int id_unfollowed, int id_lo
 }
 
 bool analyzer_follow_agent(AnalysisState& state, int agent, double time_of_follow) {
+    return state.follow_kernel(state, agent, time_of_follow);
+}
+
+template <FollowModel MODEL, bool BARABASI, bool SIDE_EFFECTS>
+static bool follow_kernel(AnalysisState& state, int agent, double time_of_follow) {
     PERF_TIMER();
     AnalyzerFollow analyzer(state);
-    return analyzer.follow_agent(agent, time_of_follow);
+    return analyzer.follow_agent<MODEL, BARABASI, SIDE_EFFECTS>(agent, time_of_follow);
+}
+
+template <FollowModel MODEL>
+static FollowKernel follow_kernel(bool barabasi, bool side_effects) {
+    if (barabasi) {
+        return side_effects ? follow_kernel<MODEL, true, true> : follow_kernel<MODEL, true, false>;
+    }
+    return side_effects ? follow_kernel<MODEL, false, true> : follow_kernel<MODEL, false, false>;
+}
+
+FollowKernel analyzer_follow_kernel(const ParsedConfig& config) {
+    bool side_effects = config.stage1_unfollow || config.use_followback;
+    switch (config.follow_model) {
+    case RANDOM_FOLLOW:
+        return follow_kernel<RANDOM_FOLLOW>(config.use_barabasi, side_effects);
+    case TWITTER_PREFERENTIAL_FOLLOW:
+        return follow_kernel<TWITTER_PREFERENTIAL_FOLLOW>(config.use_barabasi, side_effects);
+    case AGENT_FOLLOW:
+        return follow_kernel<AGENT_FOLLOW>(config.use_barabasi, side_effects);
+    case PREFERENTIAL_AGENT_FOLLOW:
+        return follow_kernel<PREFERENTIAL_AGENT_FOLLOW>(config.use_barabasi, side_effects);
+    case HASHTAG_FOLLOW:
+        return follow_kernel<HASHTAG_FOLLOW>(config.use_barabasi, side_effects);
+    case TWITTER_FOLLOW:
+        return follow_kernel<TWITTER_FOLLOW>(config.use_barabasi, side_effects);
+    default:
+        ASSERT(false, "Unknown follow model!");
+        return NULL;
+    }
 }
 
 bool analyzer_followback(AnalysisState& state, int follower, int followed) {
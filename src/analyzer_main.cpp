@@ -127,9 +127,19 @@ struct Analyzer {
 
     ofstream DATA_TIME; // Output file to plot data
 
+    // Measuring memory walks every agent, so the last measurement is reused until
+    // enough real time has passed (see MEMORY_MEASURE_SPACING):
+    MemoryUsage memory;
+    double memory_measured_at = -1, memory_measure_seconds = 0;
+
     double& time;
 
     Timer max_sim_timer;
+    // Times the interval between checkpoints
+    Timer checkpoint_timer;
+
+    // Whether the network being loaded was saved under another configuration, see fix_agents_upon_resubmission.
+    bool loaded_config_changed = false;
 
     /***************************************************************************
      * Initialization functions
@@ -147,7 +157,7 @@ struct Analyzer {
             rng(state.rng), time(state.time), add_rates(state.config.add_rates), tweet_bank(state.tweet_bank),
             most_pop_tweet(state.most_pop_tweet), hashtags(state.hashtags), output_time_checker(output_time_checker_from_config(state.config)) {
 
-        // The following allocates a memory chunk proportional to max_agents:
+        // Agent storage is allocated in blocks as the network grows, up to max_agents:
         network.allocate(config.max_agents);
 
         DATA_TIME.open("output/DATA_vs_TIME");
@@ -164,6 +174,17 @@ struct Analyzer {
         }
     }
     void set_initial_agents() {
+        if (config.initial_graph.enabled()) {
+            analyzer_load_initial_graph(state);
+            return;
+        }
+        if (config.use_bulk_initial_agents) {
+            if (analyzer_can_bulk_create_agents(state)) {
+                analyzer_bulk_create_agents(state, config.initial_agents);
+                return;
+            }
+            cout << "Note: use_bulk_initial_agents is not supported with these follow options, creating initial agents one at a time.\n";
+        }
         for (int i = 0; i < config.initial_agents; i++) {
              action_create_agent();
         }
@@ -201,6 +222,10 @@ struct Analyzer {
         const int MINUTE_TO_MICROSECOND = 60*1000000LL;
         return (max_sim_timer.get_microseconds() < (config.max_real_time * MINUTE_TO_MICROSECOND));
     }
+    bool checkpoint_check() {
+        const int MINUTE_TO_MICROSECOND = 60*1000000LL;
+        return (checkpoint_timer.get_microseconds() >= (config.checkpoint_interval * MINUTE_TO_MICROSECOND));
+    }
     void interrupt_reset() {
         SIGNAL_ATTEMPTS = 0;
     }
@@ -208,40 +233,24 @@ struct Analyzer {
         return (SIGNAL_ATTEMPTS == 0);
     }
 
-    vector<int> zeros(int size) {
-        vector<int> return_vec;
-        for (int i = 0; i < size; i ++) {
-            return_vec.push_back(0);
-        }
-        return return_vec;
-    }
-
+    // A network saved under another configuration: the languages of its regions may differ, so each agent
+    // picks its language again, and the follower sets, which are classified by language, are filled anew.
     void fix_agents_upon_resubmission(AnalysisState& state) {
         Network& n = state.network;
-        auto& R = state.config.regions;
         cout << "Fixing agents who have changed attributes...\n";
-        vector<int> ids = zeros(n.size());
-        for (int i = 0; i < n.size(); i ++) {
-            Agent& a = n[i];
-            if (!ids[i]) {
-                auto& region = R.regions[a.region_bin];
-                a.language = (Language) rng.kmc_select(region.language_probs);
-                ids[i] ++;
-            }
-            auto temp = network.follower_set(a.id).as_vector();
-            FollowerSet empty_follower_set;
-            a.follower_set = empty_follower_set;
-            for (int j = 0; j < temp.size(); j ++) {
-                Agent& f = n[temp[j]];
-                if (!ids[j]) {
-                    auto& region = R.regions[f.region_bin];
-                    f.language = (Language) rng.kmc_select(region.language_probs);
-                    ids[temp[j]] ++;
-                }
-                analyzer_handle_follow(state, f.id, a.id, 0);
-            }
+        for (Agent& a : n) {
+            a.language = (Language) state.alias_tables.region_language[a.region_bin].pick(rng);
+        }
+        vector<Agent*> followers;
+        for (Agent& a : n) {
+            followers.clear();
+            a.follower_set().for_each([&](int id_follower) {
+                followers.push_back(&n[id_follower]);
+            });
+            a.follower_set().clear();
+            a.follower_set().add_all(followers);
         }
-      }
+    }
 
     template <typename Archive>
     void load_network_state(ifstream& file) {
@@ -249,29 +258,47 @@ struct Analyzer {
         // Deserialize the INFILE:
         string saved_config_file = config.entire_config_file;
         reader(NVP(saved_config_file));
-        if (!config.ignore_load_config_check && saved_config_file != config.entire_config_file) {
-            error_exit("Error, config file does not exactly match the one being loaded from!\n"
-                    "If you do not care, please set output.ignore_load_config_check to true.\nExiting...");
-        }
+        check_saved_config(saved_config_file);
         // Deserialize the state:
         reader(NVP(state));
+    }
 
+    void check_saved_config(const string& saved_config_file) {
+        analyzer_check_saved_config(state, saved_config_file);
+    }
+
+    void finish_loading_network_state() {
         /* Synchronize rates from the loaded configuration.
          * This is done because, although we can load a new configuration,
          * some rates remain duplicated in our state object. */
         state.sync_rates();
 
         lua_hook_load_network(state);
-        fix_agents_upon_resubmission(state);
+        // Under the same configuration, the agents are loaded exactly as they were saved:
+        if (loaded_config_changed) {
+            fix_agents_upon_resubmission(state);
+        }
     }
 
     void load_network_state(std::string fname) {
         cout << "LOADING NETWORK STATE FROM " << fname << endl;
-        ifstream file {fname};
-        if (ends_with(fname, ".json")) {
-            load_network_state<JsonReader>(file);
+        // The network is replaced wholesale, the next checkpoint must be a full snapshot:
+        state.checkpoints = CheckpointLog();
+        // Likewise the degree histograms, which are built again below:
+        state.degree_histograms = DegreeHistograms();
+        if (ends_with(fname, ".snap")) {
+            analyzer_load_snapshot(state, fname.c_str());
         } else {
-            load_network_state<BinaryReader>(file);
+            ifstream file {fname};
+            if (ends_with(fname, ".json")) {
+                load_network_state<JsonReader>(file);
+            } else {
+                load_network_state<BinaryReader>(file);
+            }
+        }
+        finish_loading_network_state();
+        if (config.degree_distributions) {
+            state.degree_histograms.build(network, agent_types.size());
         }
     }
 
@@ -279,16 +306,20 @@ struct Analyzer {
     void save_network_state(ofstream& file) {
         Archive writer {state, file};
         lua_hook_save_network(state);
-        // Serialize the INFILE:
-        std::string saved_config_file;
+        // Serialize the INFILE, for the config check on load:
+        std::string saved_config_file = config.entire_config_file;
         writer(NVP(saved_config_file));
-        config.entire_config_file = saved_config_file;
         // Serialize the state:
         writer(NVP(state));
     }
 
     void save_network_state(std::string fname) {
         cout << "\n\nSAVING NETWORK STATE TO " << fname << endl;
+        if (ends_with(fname, ".snap")) {
+            lua_hook_save_network(state);
+            analyzer_save_snapshot(state, fname.c_str());
+            return;
+        }
         ofstream file {fname}; 
         if (ends_with(fname, ".json")) {
             save_network_state<JsonWriter>(file);
@@ -310,7 +341,62 @@ struct Analyzer {
             << "Retweets" << setw(25)
             << "Unfollows" << setw(25)
             << "Cumulative-Rate" << setw(25)
-            << "Real Time (s)" << "\n\n";
+            << "Real Time (s)" << setw(25)
+            << "Memory (MB)" << "\n\n";
+        if (config.degree_distributions && !state.degree_histograms.enabled) {
+            // The initial (or loaded) network is in place; from here on, follows keep the histograms current:
+            state.degree_histograms.build(network, agent_types.size());
+        }
+        while (dispatch_steps(timer)) {
+            // Interactive mode ran, and may have changed the configuration; select the kernels again.
+        }
+        // The final checkpoint may build on the ones still being written:
+        analyzer_poll_background_checkpoints(state, /*wait*/ true);
+        if (config.save_network_on_timeout) {
+            if (config.checkpoint_interval > 0) {
+                // Only what changed since the last checkpoint needs saving:
+                lua_hook_save_network(state);
+                analyzer_checkpoint(state, config.save_file.c_str());
+            } else {
+                save_network_state(config.save_file.c_str());
+            }
+        }
+    }
+
+    void checkpoint() {
+        checkpoint_timer.start();
+        if (config.checkpoint_fork) {
+            analyzer_poll_background_checkpoints(state, false);
+            if (!analyzer_background_checkpoint_ready(state)) {
+                // The next one covers the changes of this interval as well:
+                cout << "\nCHECKPOINT: skipped, " << state.checkpoints.background.size()
+                        << " background checkpoints still being written." << endl;
+                return;
+            }
+        }
+        lua_hook_save_network(state);
+        if (config.checkpoint_fork) {
+            analyzer_checkpoint_in_background(state, config.save_file.c_str());
+        } else {
+            analyzer_checkpoint(state, config.save_file.c_str());
+        }
+    }
+
+    /* Run the step loop specialized for the current configuration.
+     * Returns true if it should be dispatched again, after interactive mode. */
+    bool dispatch_steps(Timer& timer) {
+        state.follow_kernel = analyzer_follow_kernel(config);
+        // Rarely used, per-step features are grouped into one flag, and checked individually only if set:
+        bool step_extras = config.use_susceptibility || config.enable_query_api || config.checkpoint_interval > 0
+                || config.enable_lua_hooks || state.event_callbacks.on_step_analysis != NULL;
+        if (config.use_random_time_increment) {
+            return step_extras ? run_steps<true, true>(timer) : run_steps<true, false>(timer);
+        }
+        return step_extras ? run_steps<false, true>(timer) : run_steps<false, false>(timer);
+    }
+
+    template <bool RANDOM_TIME_INCREMENT, bool STEP_EXTRAS>
+    bool run_steps(Timer& timer) {
         while (sim_time_check() && real_time_check() && !stats.user_did_exit) {
             if (!interrupt_check()) {
                 interrupt_reset();
@@ -322,14 +408,13 @@ struct Analyzer {
                     stats.user_did_exit = true;
                     break;
                 }
+                return true;
             }
-        	if (!step_analysis(timer)) {
+        	if (!step_analysis<RANDOM_TIME_INCREMENT, STEP_EXTRAS>(timer)) {
         	    break;
         	}
         }
-        if (config.save_network_on_timeout) {
-            save_network_state(config.save_file.c_str());
-        }
+        return false;
     }
 
     /* Create a new agent at the next index. */
@@ -348,37 +433,25 @@ struct Analyzer {
         Agent& e = network[id];
 
         e.id = id;
-
-        // Determine abstract location:
-        auto& R = state.config.regions;
-        ASSERT(R.regions.size() <= N_BIN_REGIONS, "Too many regions!");
-        int region_bin = rng.kmc_select(R.add_probs);
-        auto& region = R.regions[region_bin];
-
-        e.region_bin = region_bin;
-        e.ideology_bin = rng.kmc_select(region.ideology_probs);
         e.creation_time = creation_time;
-        e.language = (Language) rng.kmc_select(region.language_probs);
-        // For now, either always mark ideology, or never
-        e.ideology_tweet_percent = rng.random_chance(0.5) ? 1.0 : 0.0;
-        e.preference_class = rng.kmc_select(region.preference_class_probs);
-
-        double rand_num = rng.rand_real_not0();
-        for (int et = 0; et < agent_types.size(); et++) {
-            AgentType& type = agent_types[et];
-            if (rand_num <= type.prob_add) {
-                e.agent_type = et;
-                type.agents.agent_ids.push_back(id);
-                follow_ranks.categorize(id, e.follower_set.size());
-                type.follow_ranks.categorize(id, e.follower_set.size());
-                break;
-            }
-            rand_num -= agent_types[et].prob_add;
+        ASSERT(state.config.regions.regions.size() <= N_BIN_REGIONS, "Too many regions!");
+        analyzer_pick_agent_attributes(state, e, rng);
+        state.checkpoints.mark_agent(id);
+        if (state.degree_histograms.enabled) {
+            state.degree_histograms.add_agent(e);
         }
 
+        int et = e.agent_type;
+        AgentType& type = agent_types[et];
+        type.agents.agent_ids.push_back(id);
+        follow_ranks.categorize(id, e.follower_set().size());
+        type.follow_ranks.categorize(id, e.follower_set().size());
+
         lua_hook_add(state, id);
 
         if (config.use_barabasi){
+            state.preferential_sampler.add_agent(e.follower_set().size());
+            DEBUG_CHECK(state.preferential_sampler.size() == network.size(), "Preferential sampler out of sync with network!");
             // follow so many times depending on setting
             for (int i = 0; i < config.barabasi_connections; i ++) {
                 analyzer_follow_agent(state, id, creation_time);
@@ -398,7 +471,7 @@ struct Analyzer {
         ti->time_of_tweet = time;
 //        ti->type = agent_type;
         ti->ideology_bin = e_original_author.ideology_bin;
-        ti->type = (TweetType)rng.kmc_select(agent_type.tweet_type_probs, N_TWEET_TYPES);
+        ti->type = (TweetType)state.alias_tables.agent_type_tweet_type[agent].pick(rng);
         // TODO: Pick
         Language lang = e_original_author.language;
 
@@ -428,22 +501,26 @@ struct Analyzer {
         tweet.id_link = id_link;
         tweet.generation = generation;
         // if this is a hashtag and not a retweet, we have to add the agent id into 
-        // the circular buffer. 
+        // the recent authors of the chosen topic.
         if (include_hashtag() && generation == 0) {
             RECORD_STAT(state, e_tweeter.agent_type, n_hashtags);
             tweet.hashtag = true;
-            hashtags.hashtag_groups[e_author.ideology_bin][e_author.region_bin].circ_buffer.add(e_author.id);
+            content->hashtag_bin = hashtags.choose_topic(rng, e_author.ideology_bin, e_author.region_bin, time);
+            hashtags.add(content->hashtag_bin, e_author.id, time);
         }
 
         // Always start in the first retweet time bin:
         tweet.retweet_time_bin = 0;
         tweet.retweet_next_rebin_time = time + config.tweet_obs.initial_resolution;
 
-        /* Determines reaction weights for the tweet: */
-        double total_weight = e_tweeter.follower_set.determine_tweet_weights(e_author, *content, config.tweet_react_rates, tweet.react_weights);
+        /* Determines the total reaction weight for the tweet, from the follower set's cached counts: */
+        tweet.react_weight = e_tweeter.follower_set().total_tweet_weight(e_author, *content, config.tweet_react_rates);
+        if (generation > 0) {
+            analyzer_exclude_past_reactors(state, tweet);
+        }
 
         /* Only consider tweets that can actually be retweeted. */
-        if (total_weight != 0) {
+        if (tweet.react_weight != 0) {
             state.tweet_bank.add(tweet);
         }
 
@@ -458,6 +535,7 @@ struct Analyzer {
         Agent& e = network[id_tweeter];
         tweet_ranks.categorize(id_tweeter, e.n_tweets);
         e.n_tweets++;
+        state.checkpoints.mark_agent(id_tweeter);
         Tweet tweet = generate_tweet(id_tweeter, id_tweeter, 0, generate_tweet_content(id_tweeter));
         analyzer_api_tweet(state, tweet);
         lua_hook_tweet(state, id_tweeter, tweet);
@@ -497,6 +575,7 @@ struct Analyzer {
         Tweet tweet = generate_tweet(choice.id_observer, choice.id_link, choice.generation, *choice.content);
 
         e_observer.n_retweets ++;
+        state.checkpoints.mark_agent(choice.id_observer);
         lua_hook_retweet(state, choice.id_observer, tweet);
         RECORD_STAT(state, e_observer.agent_type, n_retweets);
 
@@ -530,6 +609,9 @@ struct Analyzer {
 
     // Performs one step of the analysis routine.
     // Takes old time, returns new time
+    // Specialized on use_random_time_increment, and on whether any of use_susceptibility,
+    // enable_query_api or the step hooks are in use (STEP_EXTRAS).
+    template <bool RANDOM_TIME_INCREMENT, bool STEP_EXTRAS>
     bool step_analysis(Timer& timer) {
         PERF_TIMER();
 
@@ -549,7 +631,7 @@ struct Analyzer {
         }
 
         //Handling susceptibility
-        if (config.use_susceptibility && stats.n_steps % 10 == 0){
+        if (STEP_EXTRAS && config.use_susceptibility && stats.n_steps % 10 == 0){
 
             ofstream change_in_agent_ideology_output_file;
 
@@ -561,7 +643,7 @@ struct Analyzer {
             change_in_agent_ideology_output_file << "\nn_steps: " << stats.n_steps;
 
             for (Agent& agent : network) {
-                if (agent.susceptibility == 1.0) {
+                if (agent.details().susceptibility == 1.0) {
 
                     change_in_agent_ideology_output_file << "\n\nagent_id: " << agent.id;
 
@@ -574,21 +656,26 @@ struct Analyzer {
                     for (int& count : counts) {
                         count = 0; // Counts start at 0
                     }
-                    for (int following_id : agent.following_set.as_vector()) {
+                    for (int following_id : agent.following_set().as_vector()) {
                         Agent& following = network[following_id];
                         counts[following.ideology_bin]++;
                     }
 
+                    // Only configured ideologies have a bin in the (collapsed) follower sets:
+                    int n_ideologies = min<int>(N_BIN_IDEOLOGIES, config.ideologies.size());
                     int most_common_ideology = -1;
-                    int max_count = -1;
-                    for (int i = 0; i < N_BIN_IDEOLOGIES; i++) {
-                        if (counts[i] >= max_count) {
+                    int max_count = 0;
+                    for (int i = 0; i < n_ideologies; i++) {
+                        if (counts[i] > 0 && counts[i] >= max_count) {
                             max_count = counts[i];
                             most_common_ideology = i;
                         }
                     }
 
-                    change_agent_ideology(agent, most_common_ideology);
+                    // An agent following nobody keeps its ideology:
+                    if (most_common_ideology != -1 && most_common_ideology != agent.ideology_bin) {
+                        change_agent_ideology(agent, most_common_ideology);
+                    }
 
                 }
 
@@ -599,7 +686,19 @@ struct Analyzer {
         }
 
         // Check for incoming api_requests, if enabled.
-        analyzer_handle_outstanding_api_request(state);
+        if (STEP_EXTRAS && config.enable_query_api) {
+            analyzer_handle_outstanding_api_request(state);
+        }
+
+        if (STEP_EXTRAS && config.checkpoint_interval > 0) {
+            // Cheap, but still a system call; only every so often:
+            if (!state.checkpoints.background.empty() && stats.n_steps % 1000 == 0) {
+                analyzer_poll_background_checkpoints(state, false);
+            }
+            if (checkpoint_check()) {
+                checkpoint();
+            }
+        }
 
         /*
          * Fix for Github issue #3:
@@ -621,12 +720,14 @@ struct Analyzer {
         if (subtract_var(r, stats.prob_do_nothing) <= ZEROTOL) {
             // Do nothing. Only step time forward.
             // Does not count as a real step (i.e., does not trigger action hooks).
-            step_time(timer);
+            step_time<RANDOM_TIME_INCREMENT>(timer);
             stats.n_do_nothing_steps++;
             return true;
         }
 
-        lua_hook_step_analysis(state);
+        if (STEP_EXTRAS) {
+            lua_hook_step_analysis(state);
+        }
         // Decide what action corresponds to our random number.
         if (subtract_var(r, stats.prob_add) <= ZEROTOL) {
             // The agent creation event
@@ -635,7 +736,7 @@ struct Analyzer {
             // The follow event
             int agent = analyzer_select_agent(state, FOLLOW_SELECT);
             if (agent != -1) {
-                analyzer_follow_agent(state, agent, time);
+                state.follow_kernel(state, agent, time);
             }
         } else if (subtract_var(r, stats.prob_tweet) <= ZEROTOL) {
             // The tweet event
@@ -653,7 +754,7 @@ struct Analyzer {
             error_exit("step_analysis: event out of bounds");
         }
 
-        step_time(timer);
+        step_time<RANDOM_TIME_INCREMENT>(timer);
         stats.n_steps++;
 
         //update the rates if n_agents has changed
@@ -663,8 +764,9 @@ struct Analyzer {
     }
 
     /* Step our KMC simulation proportionally to the global event rate. */
+    template <bool RANDOM_TIME_INCREMENT>
     void step_time(Timer& timer) {
-        if (config.use_random_time_increment) {
+        if (RANDOM_TIME_INCREMENT) {
             // increment by random time
             double increment = -log(rng.rand_real_not0()) / stats.adjusted_event_rate;
             time += increment;
@@ -747,7 +849,7 @@ struct Analyzer {
         }
     }
 
-    void output_summary_stats(ostream& stream, bool newline, Timer& timer) {
+    void output_summary_stats(ostream& stream, bool newline, Timer& timer, MemoryUsage& memory) {
         if (newline) {
             stream << scientific << setprecision(8) << setw(25)
             << time << setw(25)
@@ -758,7 +860,12 @@ struct Analyzer {
             << stats.global_stats.n_retweets << setw(25)
             << stats.global_stats.n_unfollows << setw(25)
             << stats.event_rate << setw(25)
-            << timer.get_microseconds()*1e-6 << "\n";
+            << timer.get_microseconds()*1e-6;
+            // Memory breakdown, in bytes:
+            memory.for_each([&](const char* name, size_t bytes) {
+                stream << setw(25) << (double) bytes;
+            });
+            stream << setw(25) << (double) memory.total() << "\n";
             flush(stream);
         } else {
             stream << setprecision(2) << scientific << setw(25)
@@ -770,7 +877,8 @@ struct Analyzer {
             << (double) stats.global_stats.n_retweets << setw(25)
             << (double) stats.global_stats.n_unfollows << setw(25)
             << stats.event_rate << setw(25)
-            << timer.get_microseconds()*1e-6 << "\r";
+            << timer.get_microseconds()*1e-6 << setw(25)
+            << memory.total() / (1024.0 * 1024.0) << "\r";
             flush(stream);
         }
     }
@@ -786,12 +894,22 @@ struct Analyzer {
             << "Retweets" << setw(25)
             << "Unfollows" << setw(25)
             << "Cumulative-Rate" << setw(25)
-            << "Real Time (s)" << "\n";
+            << "Real Time (s)";
+            MemoryUsage().for_each([&](const char* name, size_t bytes) {
+                DATA_TIME << setw(25) << (string("Mem-") + name + " (B)");
+            });
+            DATA_TIME << setw(25) << "Mem-Total (B)" << "\n";
         }
 
         if (stats.n_outputs % STDOUT_OUTPUT_RATE == 0) {
-            output_summary_stats(DATA_TIME, true, timer);
-            output_summary_stats(cout, false, timer);
+            double now = timer.get_microseconds() * 1e-6;
+            if (memory_measured_at < 0 || now - memory_measured_at >= memory_measure_seconds * MEMORY_MEASURE_SPACING) {
+                memory = analyzer_memory_usage(state);
+                memory_measured_at = timer.get_microseconds() * 1e-6;
+                memory_measure_seconds = memory_measured_at - now;
+            }
+            output_summary_stats(DATA_TIME, true, timer, memory);
+            output_summary_stats(cout, false, timer, memory);
         }
 
         stats.n_outputs++;
@@ -800,17 +918,35 @@ struct Analyzer {
 
     //Cardinal function handling susceptibility
     void change_agent_ideology(Agent& agent, int new_ideology_bin) {
-        vector<int> followings = agent.following_set.as_vector();
+        vector<int> followings = agent.following_set().as_vector();
+        // The agent moves to another leaf of its followings' follower sets, and of their tweets' excluded counts:
         for (int following : followings) {
-            network[following].follower_set.remove(agent);
+            network[following].follower_set().remove(agent);
+            analyzer_forget_excluded_follower(state, following, agent.id);
         }
         agent.ideology_bin = new_ideology_bin;
+        state.checkpoints.mark_agent(agent.id);
         for (int following : followings) {
-            network[following].follower_set.add(agent);
+            network[following].follower_set().add(agent);
+            analyzer_exclude_new_follower(state, following, agent.id);
         }
     }
 };
 
+void analyzer_pick_agent_attributes(AnalysisState& state, Agent& e, MTwist& rng) {
+    // Determine abstract location:
+    ConfigAliasTables& tables = state.alias_tables;
+    int region_bin = tables.region_add.pick(rng);
+
+    e.region_bin = region_bin;
+    e.ideology_bin = tables.region_ideology[region_bin].pick(rng);
+    e.language = (Language) tables.region_language[region_bin].pick(rng);
+    // For now, either always mark ideology, or never
+    e.details().ideology_tweet_percent = rng.random_chance(0.5) ? 1.0 : 0.0;
+    e.preference_class = tables.region_preference_class[region_bin].pick(rng);
+    e.agent_type = tables.agent_type_add.pick(rng);
+}
+
 bool analyzer_create_agent(AnalysisState& state) {
     ASSERT(state.analyzer.get(), "Analysis is not active!");
     return state.analyzer->action_create_agent();
@@ -826,6 +962,18 @@ void analyzer_save_network_state(AnalysisState& state, const char* fname) {
     state.analyzer->save_network_state(fname);
 }
 
+// Only needs the configuration, so that snapshots can be loaded outside of analysis (eg, by the tests).
+void analyzer_check_saved_config(AnalysisState& state, const std::string& saved_config_file) {
+    bool changed = (saved_config_file != state.config.entire_config_file);
+    if (!state.config.ignore_load_config_check && changed) {
+        error_exit("Error, config file does not exactly match the one being loaded from!\n"
+                "If you do not care, please set output.ignore_load_config_check to true.\nExiting...");
+    }
+    if (state.analyzer.get()) {
+        state.analyzer->loaded_config_changed = changed;
+    }
+}
+
 void analyzer_load_network_state(AnalysisState& state, const char* fname) {
     ASSERT(state.analyzer.get(), "Analysis is not active!");
     state.analyzer->load_network_state(fname);
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of 
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors. 
+ */
+
+#include <sys/resource.h>
+
+#include "analyzer.h"
+
+using namespace std;
+
+struct AnalyzerMemory {
+    //** Note: Only use reference types here!!
+    Network& network;
+    AnalysisState& state;
+    AgentTypeVector& agent_types;
+    // There are multiple 'Analyzer's, they each operate on parts of AnalysisState.
+    AnalyzerMemory(AnalysisState& state) :
+            network(state.network), state(state), agent_types(state.agent_types) {
+    }
+
+    size_t categories_usage() {
+        size_t usage = state.tweet_ranks.memory_usage()
+                + state.follow_ranks.memory_usage()
+                + state.retweet_ranks.memory_usage()
+                + agent_types.capacity() * sizeof(AgentType);
+        for (AgentType& et : agent_types) {
+            // The grouper and agent list are embedded in the agent type:
+            usage += et.follow_ranks.memory_usage() - sizeof(et.follow_ranks);
+            usage += et.agents.memory_usage() - sizeof(et.agents);
+        }
+        return usage + state.preferential_sampler.memory_usage();
+    }
+
+    size_t old_tweets_usage() {
+        vector<Tweet>& old_tweets = state.old_tweets;
+        size_t usage = old_tweets.capacity() * sizeof(Tweet);
+        for (Tweet& tweet : old_tweets) {
+            usage += tweet.content_memory_usage();
+        }
+        return usage;
+    }
+
+    // Peak resident set size, as reported by the OS.
+    size_t peak_resident() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+#ifdef __APPLE__
+        return usage.ru_maxrss; // Already in bytes
+#else
+        return usage.ru_maxrss * 1024; // In kilobytes
+#endif
+    }
+
+    MemoryUsage memory_usage() {
+        PERF_TIMER();
+        MemoryUsage usage;
+        network.memory_usage(usage.agents, usage.following_sets, usage.follower_sets);
+        // Checkpoint dirty tracking is per agent:
+        usage.agents += state.checkpoints.memory_usage();
+        usage.categories = categories_usage();
+        usage.tweet_bank = state.tweet_bank.memory_usage();
+        usage.old_tweets = old_tweets_usage();
+        usage.hashtags = state.hashtags.memory_usage();
+        usage.peak_resident = peak_resident();
+        return usage;
+    }
+};
+
+MemoryUsage analyzer_memory_usage(AnalysisState& state) {
+    AnalyzerMemory analyzer(state);
+    return analyzer.memory_usage();
+}
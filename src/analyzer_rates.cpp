@@ -72,16 +72,25 @@ struct AnalyzerRates {
         }
 
         if (crossed_month && config.degree_distributions) {
+            NetworkSweep sweep;
+            sweep.degrees = config.degree_distributions;
+            sweep.regions = config.region_connection_matrix;
+            sweep_network(network, state, sweep);
             if (config.degree_distributions) {
-                degree_distributions(network, state);
+                degree_distributions(state, sweep);
             }
             if (config.region_connection_matrix) {
-                region_stats(network, state);
+                region_stats(state, sweep);
             }
             //fraction_of_connections_distro(network, state, stats);
             
             //cout << "\nNumber of Months = " << state.n_months() << "\n\n";
         }
+        if (crossed_month && config.graph_export) {
+            char name[64];
+            sprintf(name, "graph_month_%03d", state.n_months());
+            export_graph(state, name);
+        }
     }
 
     // after every iteration, make sure the rates are updated accordingly
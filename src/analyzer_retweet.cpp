@@ -59,22 +59,39 @@ struct AnalyzerRetweet {
         TweetBank& tweet_bank = state.tweet_bank;
 
         Tweet& tweet = tweet_bank.pick_random_weighted(rng);
-        UsedAgents& used = tweet.content->used_agents;
+        TweetContent& content = *tweet.content;
+        UsedAgents& used = content.used_agents;
 
         Agent& e = network[tweet.id_tweeter];
+        Agent& author = network[content.id_original_author];
         int agent_retweeting = -1;
 
-        if (!e.follower_set.pick_random_weighted(rng, tweet.react_weights, agent_retweeting)) {
+        // The detailed weights are only needed now that the tweet has been picked:
+        FollowerSet::Weights react_weights;
+        double total_weight = e.follower_set().determine_tweet_weights(author, content, config.tweet_react_rates, react_weights);
+        for (ExcludedCount& excluded : tweet.excluded) {
+            total_weight = e.follower_set().exclude_tweet_weight(excluded.leaf_key, excluded.count, author, content,
+                    config.tweet_react_rates, react_weights);
+        }
+        if (total_weight == 0) {
+            // Every follower that could react has since unfollowed.
+            return RetweetChoice();
+        }
+        auto is_excluded = [&](int id_agent) {
+            return content.is_excluded(id_agent);
+        };
+        if (!e.follower_set().pick_random_weighted(rng, react_weights, agent_retweeting, is_excluded)) {
             return RetweetChoice();
         }
 
         // Bug fix for #155:
         // Do not retweet if was original author.
-        // We could place the original author in used_agents, but this is more efficient.
-        bool was_tweet_author = (tweet.content->id_original_author == agent_retweeting);
-        if (!was_tweet_author && !used.contains(agent_retweeting)) {
+        // Followers that cannot react are excluded from the weights above, and the pick skips them,
+        // so this only guards against picking from an emptied set.
+        if (!content.is_excluded(agent_retweeting)) {
             // Agent has NOT already retweeted this tweet
             used.insert(agent_retweeting);
+            exclude_from_active_tweets(content, agent_retweeting);
             return RetweetChoice(
                 tweet.content->id_original_author,
                 agent_retweeting,
@@ -86,6 +103,87 @@ struct AnalyzerRetweet {
 
         return RetweetChoice();
     }
+
+    /* Leave a follower of the tweet's tweeter, who can no longer react, out of the tweet's react_weight. */
+    void exclude_follower(Tweet& tweet, Agent& follower) {
+        TweetContent& content = *tweet.content;
+        tweet.add_excluded(FollowerSet::leaf_key(follower), +1);
+        tweet.react_weight -= FollowerSet::follower_tweet_weight(follower, network[content.id_original_author],
+                content, config.tweet_react_rates);
+        // Do not leave rounding residue behind once every follower is excluded:
+        if (tweet.react_weight < 0 || tweet.n_excluded >= network[tweet.id_tweeter].follower_set().size()) {
+            tweet.react_weight = 0;
+        }
+    }
+
+    /* Exclude the tweeter's followers that already reacted to the content from a new tweet. */
+    void exclude_past_reactors(Tweet& tweet) {
+        PERF_TIMER();
+        TweetContent& content = *tweet.content;
+        int id_tweeter = tweet.id_tweeter;
+        FollowerSet& followers = network[id_tweeter].follower_set();
+        Agent& author = network[content.id_original_author];
+        if (author.id != id_tweeter && author.following_set().contains(id_tweeter)) {
+            exclude_follower(tweet, author);
+        }
+        // Intersect from whichever side is smaller:
+        if (content.used_agents.size() < followers.size()) {
+            UsedAgents::iterator iter;
+            while (content.used_agents.iterate(iter)) {
+                int id_used = iter.get();
+                if (network[id_used].following_set().contains(id_tweeter)) {
+                    exclude_follower(tweet, network[id_used]);
+                }
+            }
+        } else {
+            followers.for_each([&](int id_follower) {
+                if (content.used_agents.contains(id_follower)) {
+                    exclude_follower(tweet, network[id_follower]);
+                }
+            });
+        }
+    }
+
+    /* 'id_agent' has reacted to 'content', and can no longer react to any of its tweets. */
+    void exclude_from_active_tweets(TweetContent& content, int id_agent) {
+        PERF_TIMER();
+        TweetBank& tweet_bank = state.tweet_bank;
+        Agent& agent = network[id_agent];
+        for (int ref : content.active_tweets) {
+            Tweet& tweet = tweet_bank.get(ref);
+            if (agent.following_set().contains(tweet.id_tweeter)) {
+                exclude_follower(tweet, agent);
+                tweet_bank.refresh_rate(ref);
+            }
+        }
+    }
+
+    /* 'id_follower' started following 'id_followed'. If it can no longer react to the content of one of
+     * the followed's tweets, it is counted among the tweet's excluded followers too. Its weight was never
+     * part of the tweet's react_weight, which stays as is. */
+    void exclude_new_follower(int id_followed, int id_follower) {
+        update_excluded_counts(id_followed, id_follower, +1);
+    }
+
+    /* 'id_lost_follower' unfollowed 'id_unfollowed', it is no longer among the followers its tweets exclude.
+     * Its weight was already left out of their react_weight, which stays as is. */
+    void forget_excluded_follower(int id_unfollowed, int id_lost_follower) {
+        update_excluded_counts(id_unfollowed, id_lost_follower, -1);
+    }
+
+    void update_excluded_counts(int id_tweeter, int id_follower, int delta) {
+        const vector<int>* refs = state.tweet_bank.tweets_of(id_tweeter);
+        if (refs == NULL) {
+            return;
+        }
+        int leaf_key = FollowerSet::leaf_key(network[id_follower]);
+        for (int ref : *refs) {
+            Tweet& tweet = state.tweet_bank.get(ref);
+            if (tweet.content->is_excluded(id_follower)) {
+                tweet.add_excluded(leaf_key, delta);
+            }
+        }
+    }
 };
 
 void update_retweets(AnalysisState& state) {
@@ -101,3 +199,18 @@ RetweetChoice analyzer_select_tweet_to_retweet(AnalysisState& state) {
     AnalyzerRetweet analyzer(state);
     return analyzer.tweet_to_retweet_selection();
 }
+
+void analyzer_exclude_past_reactors(AnalysisState& state, Tweet& tweet) {
+    AnalyzerRetweet analyzer(state);
+    analyzer.exclude_past_reactors(tweet);
+}
+
+void analyzer_exclude_new_follower(AnalysisState& state, int id_followed, int id_follower) {
+    AnalyzerRetweet analyzer(state);
+    analyzer.exclude_new_follower(id_followed, id_follower);
+}
+
+void analyzer_forget_excluded_follower(AnalysisState& state, int id_unfollowed, int id_lost_follower) {
+    AnalyzerRetweet analyzer(state);
+    analyzer.forget_excluded_follower(id_unfollowed, id_lost_follower);
+}
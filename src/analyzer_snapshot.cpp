@@ -0,0 +1,731 @@
+/*
+ * This file is part of the #KAT Social Network Simulator.
+ *
+ * The #KAT Social Network Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The #KAT Social Network Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the #KAT Social Network Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Addendum:
+ *
+ * Under this license, derivations of the #KAT Social Network Simulator typically must be provided in source
+ * form. The #KAT Social Network Simulator and derivations thereof may be relicensed by decision of
+ * the original authors (Kevin Ryczko & Adam Domurad, Isaac Tamblyn), as well, in the case of a derivation,
+ * subsequent authors.
+ */
+
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "analyzer.h"
+#include "util/ParallelFor.h"
+#include "util/SnapshotFile.h"
+
+using namespace std;
+
+/* Columnar network snapshots, used for save files ending in '.snap'.
+ *
+ * The cereal save files hold one archive call per edge, and rebuild every
+ * follow set from a temporary copy. Snapshots instead store:
+ *  - one fixed-width column per agent field,
+ *  - both directions of the follow graph in CSR form (an offset per agent
+ *    into one flat array of agent ids),
+ *  - the remaining state (tweet bank, ranks, statistics, RNG, ...), whose
+ *    size does not grow with the edges, as cereal binary sections, one per
+ *    AnalysisState::StatePart.
+ * Saving makes one large sequential write per section; loading maps the
+ * file and builds the follow sets straight from the mapped arrays, in
+ * parallel. Edges are inserted in the same order as the cereal path, so a
+ * snapshot resumes exactly like a cereal save of the same state.
+ *
+ * Checkpoints (output.checkpoint_interval) build on this. The first checkpoint
+ * of a run writes a full snapshot, the 'base'. Each later checkpoint writes a
+ * delta file '<save_file>.<n>' holding only what changed since the one before
+ * (see CheckpointLog): the records of the dirty agents, the follows and
+ * unfollows in order, and the state sections that changed. Loading a
+ * snapshot replays the deltas that belong to it; --compact-checkpoints folds
+ * them into a new base. */
+
+static const char SNAPSHOT_MAGIC[] = "HKSNAP";
+static const char DELTA_MAGIC[] = "HKDELTA";
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+enum SnapshotSectionId {
+    SECTION_CONFIG, // The INFILE text, for the load config check
+    SECTION_STATE, // cereal binary, the first of AnalysisState::N_STATE_PARTS sections, see serialize_state_part
+    SECTION_STATE_END = SECTION_STATE + AnalysisState::N_STATE_PARTS - 1,
+    SECTION_NETWORK_SIZE, // (n_agents, max_agents)
+    // Agent columns:
+    SECTION_AGENT_TYPE,
+    SECTION_PREFERENCE_CLASS,
+    SECTION_REGION_BIN,
+    SECTION_IDEOLOGY_BIN,
+    SECTION_LANGUAGE,
+    SECTION_CREATION_TIME,
+    SECTION_N_TWEETS,
+    SECTION_N_RETWEETS,
+    SECTION_IDEOLOGY_TWEET_PERCENT,
+    SECTION_AVG_CHATINESS,
+    SECTION_SUSCEPTIBILITY,
+    SECTION_FOLLOWING_METHOD_COUNTS, // N_FOLLOW_MODELS per agent
+    SECTION_FOLLOWER_METHOD_COUNTS,
+    // CSR arrays:
+    SECTION_CHATTY_OFFSETS,
+    SECTION_CHATTY_AGENTS,
+    SECTION_FOLLOWING_OFFSETS,
+    SECTION_FOLLOWINGS,
+    SECTION_FOLLOWER_OFFSETS,
+    SECTION_FOLLOWERS,
+    // Checkpoints:
+    SECTION_CHECKPOINT, // (base id, delta number), 0 for the base itself
+    SECTION_DIRTY_AGENTS, // Deltas only: the agents the columns are for
+    SECTION_EDGE_CHANGES // Deltas only: CheckpointLog::EdgeChange
+};
+
+static string delta_name(const string& fname, int n) {
+    return fname + "." + to_string(n);
+}
+
+struct AnalyzerSnapshot {
+    //** Note: Only use reference types here!!
+    AnalysisState& state;
+    Network& network;
+    CheckpointLog& checkpoints;
+
+    // Agents per parallel task.
+    static const int CHUNK_SIZE = 4096;
+
+    // The agents whose records are written or read, in row order; every agent if NULL.
+    const vector<int>* rows = NULL;
+    // The INFILE text of the last loaded snapshot:
+    string saved_config_file;
+    // Why the last save failed:
+    string error;
+
+    AnalyzerSnapshot(AnalysisState& state) :
+            state(state), network(state.network), checkpoints(state.checkpoints) {
+    }
+
+    int n_rows() {
+        return rows != NULL ? rows->size() : network.size();
+    }
+    Agent& row_agent(int row) {
+        return network[rows != NULL ? (*rows)[row] : row];
+    }
+
+    /***************************************************************************
+     * Saving
+     ***************************************************************************/
+
+    // Returns false, with 'error' set, if the snapshot could not be written.
+    bool save(const string& fname, const string& config_file, uint64_t base_id) {
+        PERF_TIMER();
+        SnapshotWriter writer;
+        string temp_name = fname + ".tmp";
+        if (!writer.open(temp_name, SNAPSHOT_MAGIC, SNAPSHOT_VERSION)) {
+            error = "Could not open '" + temp_name + "' for writing the network snapshot!";
+            return false;
+        }
+        writer.write_section(SECTION_CONFIG, config_file);
+        writer.write_section(SECTION_CHECKPOINT, vector<uint64_t> {base_id, 0});
+        write_state(writer, /*only changed*/ false);
+        write_agents(writer);
+        write_rows(writer, SECTION_FOLLOWING_OFFSETS, SECTION_FOLLOWINGS,
+                [](Agent& e) {return e.following_set().size();},
+                [](Agent& e, vector<int>& row) {row = e.following_set().as_vector();});
+        write_rows(writer, SECTION_FOLLOWER_OFFSETS, SECTION_FOLLOWERS,
+                [](Agent& e) {return e.follower_set().size();},
+                [](Agent& e, vector<int>& row) {
+                    e.follower_set().for_each([&](int id) {row.push_back(id);});
+                });
+        if (!finish(writer, temp_name, fname)) {
+            return false;
+        }
+
+        // Deltas on top of an older base no longer apply:
+        for (int n = 1; file_exists(delta_name(fname, n)); n++) {
+            remove(delta_name(fname, n).c_str());
+        }
+        return true;
+    }
+
+    // Write delta 'n' of the current base, from the changes in the checkpoint log.
+    bool save_delta(const string& fname, int n) {
+        PERF_TIMER();
+        DEBUG_CHECK(checkpoints.enabled, "No base snapshot to write a delta for!");
+        SnapshotWriter writer;
+        string temp_name = delta_name(fname, n) + ".tmp";
+        if (!writer.open(temp_name, DELTA_MAGIC, SNAPSHOT_VERSION)) {
+            error = "Could not open '" + temp_name + "' for writing the checkpoint!";
+            return false;
+        }
+        writer.write_section(SECTION_CHECKPOINT, vector<uint64_t> {checkpoints.base_id, (uint64_t)n});
+        write_state(writer, /*only changed*/ true);
+        // Sorted, so the records are written and replayed in memory order:
+        vector<int> dirty = checkpoints.dirty_agents;
+        sort(dirty.begin(), dirty.end());
+        writer.write_section(SECTION_DIRTY_AGENTS, dirty);
+        rows = &dirty;
+        write_agents(writer);
+        rows = NULL;
+        writer.write_section(SECTION_EDGE_CHANGES, checkpoints.edge_changes);
+        return finish(writer, temp_name, delta_name(fname, n));
+    }
+
+    /* The next checkpoint: a full snapshot under 'base_id' if the log has no base
+     * yet, otherwise the next delta on top of it. The log is left untouched, see
+     * checkpoint_written(). */
+    bool write_checkpoint(const string& fname, uint64_t base_id) {
+        if (!checkpoints.enabled) {
+            return save(fname, state.config.entire_config_file, base_id);
+        }
+        return save_delta(fname, checkpoints.n_deltas + 1);
+    }
+
+    // Move the log past the checkpoint write_checkpoint() makes, once it is written (or being written).
+    void checkpoint_written(uint64_t base_id) {
+        if (!checkpoints.enabled) {
+            checkpoints.start(base_id);
+        } else {
+            checkpoints.n_deltas++;
+            checkpoints.clear();
+        }
+    }
+
+    string checkpoint_name(const string& fname) {
+        return checkpoints.enabled ? delta_name(fname, checkpoints.n_deltas + 1) : fname;
+    }
+
+    // Each snapshot gets an id, so that stray deltas of another base are never applied to it.
+    static uint64_t new_base_id() {
+        uint64_t clock = chrono::system_clock::now().time_since_epoch().count();
+        return (clock << 16) ^ (uint64_t)getpid();
+    }
+
+    // Files are written under a temporary name first, so an interrupted save never replaces a good one.
+    bool finish(SnapshotWriter& writer, const string& temp_name, const string& fname) {
+        if (!writer.close() || rename(temp_name.c_str(), fname.c_str()) != 0) {
+            error = "Error writing the network snapshot to '" + fname + "'!";
+            return false;
+        }
+        return true;
+    }
+
+    // Write each part of the state to its own section. With 'only_changed', the parts that hash the
+    // same as when last written are left out; the tweet bank, say, is unchanged in a run without tweets.
+    void write_state(SnapshotWriter& writer, bool only_changed) {
+        vector<size_t>& fingerprints = checkpoints.state_fingerprints;
+        fingerprints.resize(AnalysisState::N_STATE_PARTS, 0);
+        for (int part = 0; part < AnalysisState::N_STATE_PARTS; part++) {
+            stringstream stream;
+            {
+                BinaryWriter archive {state, stream};
+                state.serialize_state_part(archive, (AnalysisState::StatePart)part);
+            }
+            string bytes = stream.str();
+            size_t fingerprint = hash<string>()(bytes);
+            if (only_changed && fingerprint == fingerprints[part]) {
+                continue;
+            }
+            fingerprints[part] = fingerprint;
+            writer.write_section(SECTION_STATE + part, bytes);
+        }
+        writer.write_section(SECTION_NETWORK_SIZE, vector<int64_t> {network.size(), network.max_size()});
+    }
+
+    // Every record field of the agents in 'rows', excluding their follow sets.
+    void write_agents(SnapshotWriter& writer) {
+        write_column<int>(writer, SECTION_AGENT_TYPE, [](Agent& e) {return e.agent_type;});
+        write_column<int>(writer, SECTION_PREFERENCE_CLASS, [](Agent& e) {return e.preference_class;});
+        write_column<int>(writer, SECTION_REGION_BIN, [](Agent& e) {return e.region_bin;});
+        write_column<int>(writer, SECTION_IDEOLOGY_BIN, [](Agent& e) {return e.ideology_bin;});
+        write_column<int>(writer, SECTION_LANGUAGE, [](Agent& e) {return (int)e.language;});
+        write_column<double>(writer, SECTION_CREATION_TIME, [](Agent& e) {return e.creation_time;});
+        write_column<int>(writer, SECTION_N_TWEETS, [](Agent& e) {return e.n_tweets;});
+        write_column<int>(writer, SECTION_N_RETWEETS, [](Agent& e) {return e.n_retweets;});
+        write_column<double>(writer, SECTION_IDEOLOGY_TWEET_PERCENT, [](Agent& e) {return e.details().ideology_tweet_percent;});
+        write_column<double>(writer, SECTION_AVG_CHATINESS, [](Agent& e) {return e.details().avg_chatiness;});
+        write_column<double>(writer, SECTION_SUSCEPTIBILITY, [](Agent& e) {return e.details().susceptibility;});
+
+        vector<int> method_counts;
+        method_counts.reserve((size_t)n_rows() * N_FOLLOW_MODELS);
+        for (int row = 0; row < n_rows(); row++) {
+            int* counts = row_agent(row).details().following_method_counts;
+            method_counts.insert(method_counts.end(), counts, counts + N_FOLLOW_MODELS);
+        }
+        writer.write_section(SECTION_FOLLOWING_METHOD_COUNTS, method_counts);
+        method_counts.clear();
+        for (int row = 0; row < n_rows(); row++) {
+            int* counts = row_agent(row).details().follower_method_counts;
+            method_counts.insert(method_counts.end(), counts, counts + N_FOLLOW_MODELS);
+        }
+        writer.write_section(SECTION_FOLLOWER_METHOD_COUNTS, method_counts);
+
+        write_rows(writer, SECTION_CHATTY_OFFSETS, SECTION_CHATTY_AGENTS,
+                [](Agent& e) {return e.details().chatty_agents.size();},
+                [](Agent& e, vector<int>& row) {row = e.details().chatty_agents;});
+    }
+
+    template <typename T, typename Get>
+    void write_column(SnapshotWriter& writer, SnapshotSectionId id, Get get) {
+        vector<T> column;
+        column.reserve(n_rows());
+        for (int row = 0; row < n_rows(); row++) {
+            column.push_back(get(row_agent(row)));
+        }
+        writer.write_section(id, column);
+    }
+
+    // Write a CSR array: the offsets of each agent's row, then the rows back to back.
+    template <typename Size, typename Row>
+    void write_rows(SnapshotWriter& writer, SnapshotSectionId offsets_id, SnapshotSectionId rows_id, Size size, Row row) {
+        vector<int64_t> offsets(n_rows() + 1, 0);
+        for (int i = 0; i < n_rows(); i++) {
+            offsets[i + 1] = offsets[i] + size(row_agent(i));
+        }
+        writer.write_section(offsets_id, offsets);
+        writer.begin_section(rows_id, sizeof(int));
+        vector<int> values;
+        for (int i = 0; i < n_rows(); i++) {
+            Agent& e = row_agent(i);
+            values.clear();
+            row(e, values);
+            DEBUG_CHECK(values.size() == size(e), "Row size changed while writing snapshot!");
+            writer.write(values.data(), values.size() * sizeof(int));
+        }
+    }
+
+    /***************************************************************************
+     * Loading
+     ***************************************************************************/
+
+    // Load the snapshot 'fname', and replay its checkpoint deltas. Returns the number of deltas replayed.
+    int load(const string& fname, bool check_config) {
+        PERF_TIMER();
+        SnapshotReader reader;
+        if (!reader.open(fname, SNAPSHOT_MAGIC, SNAPSHOT_VERSION)) {
+            error_exit("'" + fname + "' is not a version " + to_string(SNAPSHOT_VERSION) + " network snapshot!");
+        }
+        size_t length;
+        const char* config_text = reader.section<char>(SECTION_CONFIG, length);
+        saved_config_file = string(config_text != NULL ? config_text : "", length);
+        if (check_config) {
+            analyzer_check_saved_config(state, saved_config_file);
+        }
+        const uint64_t* checkpoint = require_section<uint64_t>(reader, SECTION_CHECKPOINT, length);
+        check_length(length, 2);
+        uint64_t base_id = checkpoint[0];
+
+        read_state(reader, /*all parts*/ true);
+        int n_agents, max_agents;
+        read_network_size(reader, n_agents, max_agents);
+        network.allocate(max_agents);
+        grow_to(n_agents);
+        read_agents(reader);
+
+        // The follower set layers classify followers by their attributes, which are all in place now:
+        network.fit_follower_dims();
+        const int64_t* offsets;
+        const int* values;
+        read_rows(reader, SECTION_FOLLOWING_OFFSETS, SECTION_FOLLOWINGS, offsets, values);
+        for_each_row([&](Agent& e, int row) {
+            e.following_set().add_all(state, values + offsets[row], offsets[row + 1] - offsets[row]);
+        });
+        read_rows(reader, SECTION_FOLLOWER_OFFSETS, SECTION_FOLLOWERS, offsets, values);
+        for_each_row([&](Agent& e, int row) {
+            vector<Agent*> followers;
+            followers.reserve(offsets[row + 1] - offsets[row]);
+            for (int64_t i = offsets[row]; i < offsets[row + 1]; i++) {
+                followers.push_back(&network[values[i]]);
+            }
+            e.follower_set().add_all(followers);
+        });
+
+        int n = 1;
+        for (; file_exists(delta_name(fname, n)); n++) {
+            if (!replay_delta(delta_name(fname, n), base_id, n)) {
+                break;
+            }
+        }
+        return n - 1;
+    }
+
+    // Returns false if the delta belongs to another base snapshot.
+    bool replay_delta(const string& fname, uint64_t base_id, int n) {
+        PERF_TIMER();
+        SnapshotReader reader;
+        if (!reader.open(fname, DELTA_MAGIC, SNAPSHOT_VERSION)) {
+            error_exit("'" + fname + "' is not a version " + to_string(SNAPSHOT_VERSION) + " checkpoint delta!");
+        }
+        size_t length;
+        const uint64_t* checkpoint = require_section<uint64_t>(reader, SECTION_CHECKPOINT, length);
+        check_length(length, 2);
+        if (checkpoint[0] != base_id) {
+            cout << "Note: '" << fname << "' was written for another base snapshot, it and any later deltas are ignored.\n";
+            return false;
+        }
+        if (checkpoint[1] != n) {
+            error_exit("'" + fname + "' is out of sequence!");
+        }
+
+        read_state(reader, /*all parts*/ false);
+        int n_old = network.size();
+        int n_agents, max_agents;
+        read_network_size(reader, n_agents, max_agents);
+        if (n_agents < n_old || max_agents != network.max_size()) {
+            error_exit("'" + fname + "' does not apply to the network loaded before it!");
+        }
+        grow_to(n_agents);
+
+        const int* dirty = require_section<int>(reader, SECTION_DIRTY_AGENTS, length);
+        vector<int> dirty_agents(dirty, dirty + length);
+        for (int id : dirty_agents) {
+            check_id(id);
+        }
+        rows = &dirty_agents;
+        // Agents that changed follower set bins (see change_agent_ideology) must move within the follower sets they are in:
+        vector<int> moved = agents_changing_bins(reader, n_old);
+        for (int id : moved) {
+            Agent& e = network[id];
+            for (int id_followed : e.following_set().as_vector()) {
+                network[id_followed].follower_set().remove(e);
+            }
+        }
+        read_agents(reader);
+        for (int id : moved) {
+            Agent& e = network[id];
+            for (int id_followed : e.following_set().as_vector()) {
+                network[id_followed].follower_set().add(e);
+            }
+        }
+        rows = NULL;
+
+        const CheckpointLog::EdgeChange* changes = require_section<CheckpointLog::EdgeChange>(reader, SECTION_EDGE_CHANGES, length);
+        for (size_t i = 0; i < length; i++) {
+            const CheckpointLog::EdgeChange& change = changes[i];
+            check_id(change.follower);
+            check_id(change.followed);
+            Agent& follower = network[change.follower];
+            Agent& followed = network[change.followed];
+            bool applied;
+            if (change.op == CheckpointLog::FOLLOW) {
+                applied = follower.following_set().add(state, change.followed) && followed.follower_set().add(follower);
+            } else {
+                applied = follower.following_set().remove(state, change.followed) && followed.follower_set().remove(follower);
+            }
+            if (!applied) {
+                error_exit("'" + fname + "' does not apply to the network loaded before it!");
+            }
+        }
+        return true;
+    }
+
+    // The existing agents among 'rows' whose follower set bins differ in the delta.
+    vector<int> agents_changing_bins(SnapshotReader& reader, int n_old) {
+        size_t length;
+        const int* langs = require_section<int>(reader, SECTION_LANGUAGE, length);
+        const int* pref_classes = require_section<int>(reader, SECTION_PREFERENCE_CLASS, length);
+        const int* regions = require_section<int>(reader, SECTION_REGION_BIN, length);
+        const int* ideologies = require_section<int>(reader, SECTION_IDEOLOGY_BIN, length);
+        check_length(length, n_rows());
+        vector<int> moved;
+        for (int row = 0; row < n_rows(); row++) {
+            Agent& e = row_agent(row);
+            if (e.id < n_old && (e.language != langs[row] || e.preference_class != pref_classes[row]
+                    || e.region_bin != regions[row] || e.ideology_bin != ideologies[row])) {
+                moved.push_back(e.id);
+            }
+        }
+        return moved;
+    }
+
+    // Read the state sections; unless 'all_parts', those missing (unchanged in a delta) are kept as they are.
+    void read_state(SnapshotReader& reader, bool all_parts) {
+        for (int part = 0; part < AnalysisState::N_STATE_PARTS; part++) {
+            size_t length;
+            SnapshotSectionId id = (SnapshotSectionId)(SECTION_STATE + part);
+            const char* bytes = all_parts ? require_section<char>(reader, id, length) : reader.section<char>(id, length);
+            if (bytes == NULL) {
+                continue;
+            }
+            SnapshotStreamBuf buffer(bytes, length);
+            istream stream(&buffer);
+            BinaryReader archive {state, stream};
+            state.serialize_state_part(archive, (AnalysisState::StatePart)part);
+        }
+    }
+
+    void read_network_size(SnapshotReader& reader, int& n_agents, int& max_agents) {
+        size_t length;
+        const int64_t* size = require_section<int64_t>(reader, SECTION_NETWORK_SIZE, length);
+        if (length != 2 || size[0] < 0 || size[0] > size[1]) {
+            error_exit("Network snapshot has a corrupt network size!");
+        }
+        n_agents = size[0], max_agents = size[1];
+    }
+
+    void grow_to(int n_agents) {
+        while (network.size() < n_agents) {
+            int id = network.size();
+            network.grow();
+            network[id].id = id;
+        }
+    }
+
+    // Every record field of the agents in 'rows', excluding their follow sets.
+    void read_agents(SnapshotReader& reader) {
+        read_column<int>(reader, SECTION_AGENT_TYPE, [](Agent& e, int v) {e.agent_type = v;});
+        read_column<int>(reader, SECTION_PREFERENCE_CLASS, [](Agent& e, int v) {e.preference_class = v;});
+        read_column<int>(reader, SECTION_REGION_BIN, [](Agent& e, int v) {e.region_bin = v;});
+        read_column<int>(reader, SECTION_IDEOLOGY_BIN, [](Agent& e, int v) {e.ideology_bin = v;});
+        read_column<int>(reader, SECTION_LANGUAGE, [](Agent& e, int v) {e.language = (Language)v;});
+        read_column<double>(reader, SECTION_CREATION_TIME, [](Agent& e, double v) {e.creation_time = v;});
+        read_column<int>(reader, SECTION_N_TWEETS, [](Agent& e, int v) {e.n_tweets = v;});
+        read_column<int>(reader, SECTION_N_RETWEETS, [](Agent& e, int v) {e.n_retweets = v;});
+        read_column<double>(reader, SECTION_IDEOLOGY_TWEET_PERCENT, [](Agent& e, double v) {e.details().ideology_tweet_percent = v;});
+        read_column<double>(reader, SECTION_AVG_CHATINESS, [](Agent& e, double v) {e.details().avg_chatiness = v;});
+        read_column<double>(reader, SECTION_SUSCEPTIBILITY, [](Agent& e, double v) {e.details().susceptibility = v;});
+
+        size_t length;
+        const int* following_methods = require_section<int>(reader, SECTION_FOLLOWING_METHOD_COUNTS, length);
+        check_length(length, (size_t)n_rows() * N_FOLLOW_MODELS);
+        const int* follower_methods = require_section<int>(reader, SECTION_FOLLOWER_METHOD_COUNTS, length);
+        check_length(length, (size_t)n_rows() * N_FOLLOW_MODELS);
+        for_each_row([&](Agent& e, int row) {
+            size_t first = (size_t)row * N_FOLLOW_MODELS;
+            copy(following_methods + first, following_methods + first + N_FOLLOW_MODELS, e.details().following_method_counts);
+            copy(follower_methods + first, follower_methods + first + N_FOLLOW_MODELS, e.details().follower_method_counts);
+        });
+
+        const int64_t* offsets;
+        const int* values;
+        read_rows(reader, SECTION_CHATTY_OFFSETS, SECTION_CHATTY_AGENTS, offsets, values);
+        for_each_row([&](Agent& e, int row) {
+            e.details().chatty_agents.assign(values + offsets[row], values + offsets[row + 1]);
+        });
+    }
+
+    template <typename T>
+    const T* require_section(SnapshotReader& reader, SnapshotSectionId id, size_t& length) {
+        const T* section = reader.section<T>(id, length);
+        if (section == NULL) {
+            error_exit("Network snapshot is missing section " + to_string((int)id) + "!");
+        }
+        return section;
+    }
+
+    void check_length(size_t length, size_t expected) {
+        if (length != expected) {
+            error_exit("Network snapshot has a section of the wrong length!");
+        }
+    }
+
+    void check_id(int id) {
+        if (!network.is_valid_id(id)) {
+            error_exit("Network snapshot refers to an agent that does not exist!");
+        }
+    }
+
+    template <typename T, typename Set>
+    void read_column(SnapshotReader& reader, SnapshotSectionId id, Set set) {
+        size_t length;
+        const T* column = require_section<T>(reader, id, length);
+        check_length(length, n_rows());
+        for_each_row([&](Agent& e, int row) {
+            set(e, column[row]);
+        });
+    }
+
+    // Map a CSR array, checking that every row is in bounds and holds valid agent ids.
+    void read_rows(SnapshotReader& reader, SnapshotSectionId offsets_id, SnapshotSectionId rows_id,
+            const int64_t*& offsets, const int*& values) {
+        size_t n_offsets, n_values;
+        offsets = require_section<int64_t>(reader, offsets_id, n_offsets);
+        values = require_section<int>(reader, rows_id, n_values);
+        check_length(n_offsets, n_rows() + 1);
+        for (int i = 0; i < n_rows(); i++) {
+            if (offsets[i] < 0 || offsets[i] > offsets[i + 1]) {
+                error_exit("Network snapshot has corrupt row offsets!");
+            }
+        }
+        check_length(n_values, offsets[n_rows()]);
+        for (size_t i = 0; i < n_values; i++) {
+            check_id(values[i]);
+        }
+    }
+
+    // Run 'func(agent, row)' on the agent of every row, in parallel over chunks of rows.
+    template <typename Func>
+    void for_each_row(Func func) {
+        int n = n_rows();
+        parallel_for((n + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](int chunk) {
+            int chunk_end = std::min(n, (chunk + 1) * CHUNK_SIZE);
+            for (int row = chunk * CHUNK_SIZE; row < chunk_end; row++) {
+                func(row_agent(row), row);
+            }
+        });
+    }
+};
+
+void analyzer_save_snapshot(AnalysisState& state, const char* fname) {
+    AnalyzerSnapshot analyzer(state);
+    if (!analyzer.save(fname, state.config.entire_config_file, AnalyzerSnapshot::new_base_id())) {
+        error_exit(analyzer.error);
+    }
+}
+
+void analyzer_load_snapshot(AnalysisState& state, const char* fname) {
+    AnalyzerSnapshot analyzer(state);
+    int n_deltas = analyzer.load(fname, /*check config*/ true);
+    if (n_deltas > 0) {
+        cout << "Replayed " << n_deltas << " checkpoint deltas.\n";
+    }
+}
+
+static void print_checkpoint(CheckpointLog& log, const string& name) {
+    if (!log.enabled) {
+        cout << "\nCHECKPOINT: full snapshot to " << name << endl;
+    } else {
+        cout << "\nCHECKPOINT: " << log.dirty_agents.size() << " changed agents and " << log.edge_changes.size()
+                << " follow changes to " << name << endl;
+    }
+}
+
+void analyzer_checkpoint(AnalysisState& state, const char* fname) {
+    AnalyzerSnapshot analyzer(state);
+    print_checkpoint(state.checkpoints, analyzer.checkpoint_name(fname));
+    uint64_t base_id = AnalyzerSnapshot::new_base_id();
+    if (!analyzer.write_checkpoint(fname, base_id)) {
+        error_exit(analyzer.error);
+    }
+    analyzer.checkpoint_written(base_id);
+}
+
+/* Background checkpoints (output.checkpoint_fork). The process forks at a step
+ * boundary, and the child writes the checkpoint from its copy-on-write view of
+ * the state while the parent simulates on. The parent treats the checkpoint as
+ * written right away, and learns whether it was from the child's exit status. */
+
+bool analyzer_background_checkpoint_ready(AnalysisState& state) {
+    CheckpointLog& log = state.checkpoints;
+    if ((int)log.background.size() >= state.config.checkpoint_max_forks) {
+        return false;
+    }
+    // A new base removes the deltas of the old one, so it must not race a delta still being written:
+    for (CheckpointLog::BackgroundWrite& write : log.background) {
+        if (write.is_base) {
+            return false;
+        }
+    }
+    return log.enabled || log.background.empty();
+}
+
+void analyzer_checkpoint_in_background(AnalysisState& state, const char* fname) {
+    DEBUG_CHECK(analyzer_background_checkpoint_ready(state), "Too many background checkpoints!");
+    CheckpointLog& log = state.checkpoints;
+    AnalyzerSnapshot analyzer(state);
+    string name = analyzer.checkpoint_name(fname);
+    uint64_t base_id = AnalyzerSnapshot::new_base_id();
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fds[0] = fds[1] = -1;
+    }
+    // Anything still buffered would otherwise be written by both processes:
+    cout.flush();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        bool ok = analyzer.write_checkpoint(fname, base_id);
+        if (!ok) {
+            cerr << analyzer.error << endl;
+        } else if (fds[1] >= 0) {
+            // Small enough to never block:
+            const vector<size_t>& fingerprints = log.state_fingerprints;
+            ssize_t n_bytes = write(fds[1], fingerprints.data(), fingerprints.size() * sizeof(size_t));
+            (void)n_bytes;
+        }
+        // Skip the exit handlers and destructors, they belong to the parent:
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        // Could not fork (eg, out of memory); write it here instead:
+        cout << "\nCHECKPOINT: could not fork, writing in the foreground." << endl;
+        analyzer_checkpoint(state, fname);
+        return;
+    }
+    print_checkpoint(log, name + " in the background");
+    log.background.push_back({pid, name, !log.enabled, Timer(), fds[0], ++log.n_forks});
+    // Which state sections the child left out is unknown until it reports back; until then, a
+    // later checkpoint writes them all:
+    log.state_fingerprints.clear();
+    analyzer.checkpoint_written(base_id);
+}
+
+// Take on the state fingerprints of a finished background checkpoint, if no checkpoint was started after it.
+static void read_background_fingerprints(CheckpointLog& log, CheckpointLog::BackgroundWrite& write) {
+    vector<size_t> fingerprints(AnalysisState::N_STATE_PARTS);
+    size_t size = fingerprints.size() * sizeof(size_t);
+    if (write.fingerprints_fd < 0 || read(write.fingerprints_fd, fingerprints.data(), size) != (ssize_t)size) {
+        return;
+    }
+    if (write.fork_number == log.n_forks && log.state_fingerprints.empty()) {
+        log.state_fingerprints = fingerprints;
+    }
+}
+
+void analyzer_poll_background_checkpoints(AnalysisState& state, bool wait) {
+    CheckpointLog& log = state.checkpoints;
+    for (size_t i = 0; i < log.background.size();) {
+        CheckpointLog::BackgroundWrite& write = log.background[i];
+        int status = 0;
+        pid_t pid = waitpid(write.pid, &status, wait ? 0 : WNOHANG);
+        if (pid == 0) {
+            i++; // Still running
+            continue;
+        }
+        long long ms = write.timer.get_microseconds() / 1000;
+        if (pid == write.pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            cout << "\nCHECKPOINT: " << write.file << " written, in " << ms << " ms." << endl;
+            read_background_fingerprints(log, write);
+        } else {
+            cout << "\nCHECKPOINT: writing " << write.file << " failed after " << ms << " ms! "
+                    << "The next checkpoint will be a full snapshot." << endl;
+            // The deltas after a lost one cannot be replayed, start over with a new base:
+            log.enabled = false;
+            log.clear();
+        }
+        if (write.fingerprints_fd >= 0) {
+            close(write.fingerprints_fd);
+        }
+        log.background.erase(log.background.begin() + i);
+    }
+}
+
+void analyzer_compact_checkpoints(AnalysisState& state, const char* fname) {
+    AnalyzerSnapshot analyzer(state);
+    int n_deltas = analyzer.load(fname, /*check config*/ false);
+    cout << "Compacting " << fname << " and " << n_deltas << " checkpoint deltas into a new base snapshot.\n";
+    // Keep the INFILE of the run that made the checkpoints:
+    if (!analyzer.save(fname, analyzer.saved_config_file, AnalyzerSnapshot::new_base_id())) {
+        error_exit(analyzer.error);
+    }
+}
@@ -22,13 +22,17 @@
  * subsequent authors. 
  */
 
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <string>
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <unistd.h>
 
 #include "dependencies/ini.h"
 #include "dependencies/UnitTest++.h"
@@ -106,43 +110,119 @@ void hashkat_finish_analysis(AnalysisState* state) {
     state->stats.user_did_exit = true;
 }
 
-static const char* copy_str(const char* str, size_t n) {
-    char* new_str = new char[n + 1];
-    memcpy(new_str, str, n + 1);
-    return new_str;
 }
 
-const char* hashkat_dump_stats(AnalysisState* state_ptr) { 
-    AnalysisState& state = *state_ptr;
-    stringstream output;
-    JsonWriter writer {state, output};
-    double time = state.time;
-    int n_agents = state.network.size();
-    state.stats.serialize(writer);
-    writer(NVP(time), NVP(n_agents));
-    string output_str = output.str();
-    return copy_str(output_str.c_str(), output_str.size());
-}
+/*
+ * Output buffer for the API dumps. Holds at most CHUNK_SIZE bytes, which are handed
+ * to the sink whenever they fill up, so a dump streams out as it is formatted.
+ */
+struct DumpStreamBuf : public std::streambuf {
+    static const size_t CHUNK_SIZE = 64 * 1024;
 
-const char* hashkat_dump_state(AnalysisState* state_ptr) { 
-    AnalysisState& state = *state_ptr;
-    stringstream output;
-    JsonWriter writer {state, output};
-    state.serialize(writer);
-    string output_str = output.str();
-    return copy_str(output_str.c_str(), output_str.size());
-}
+    DumpStreamBuf(DumpSink& sink) : sink(sink) {
+        setp(chunk, chunk + CHUNK_SIZE);
+    }
 
-void hashkat_dump_free(struct AnalysisState* state, const char* dump) {
-    delete[] dump;
+    // Writes out the last chunk. Returns false if any write failed or was stopped.
+    bool finish() {
+        return sync() == 0;
+    }
+
+protected:
+    int overflow(int c) override {
+        if (sync() != 0) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        size_t size = pptr() - pbase();
+        setp(chunk, chunk + CHUNK_SIZE);
+        if (ok && size > 0) {
+            ok = write_chunk(chunk, size);
+        }
+        return ok ? 0 : -1;
+    }
+
+private:
+    DumpSink& sink;
+    bool ok = true;
+    char chunk[CHUNK_SIZE];
+
+    bool write_chunk(const char* data, size_t size) {
+        if (sink.write_chunk != NULL) {
+            return sink.write_chunk(sink.context, data, size) == 0;
+        }
+        while (size > 0) {
+            ssize_t n_written = write(sink.fd, data, size);
+            if (n_written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n_written <= 0) {
+                return false;
+            }
+            data += n_written;
+            size -= n_written;
+        }
+        return true;
+    }
+};
+
+// Streams the JSON document written by 'func' to 'sink'.
+template <typename Func>
+static int stream_json(AnalysisState& state, DumpSink& sink, Func func) {
+    DumpStreamBuf buffer {sink};
+    std::ostream stream {&buffer};
+    { // Scope off 'writer', which closes the document when destroyed
+        JsonWriter writer {state, stream};
+        func(writer);
+    }
+    return buffer.finish() ? 0 : -1;
 }
+
+// A malloc'd string, grown in place as the chunks arrive, for the hashkat_dump_* functions.
+struct DumpString {
+    char* data = NULL;
+    size_t size = 0, capacity = 0;
+
+    static int append(void* context, const char* chunk, size_t n) {
+        DumpString& str = *(DumpString*)context;
+        if (str.size + n + 1 > str.capacity) {
+            size_t capacity = std::max(2 * str.capacity, str.size + n + 1);
+            char* data = (char*)realloc(str.data, capacity);
+            if (data == NULL) {
+                return -1;
+            }
+            str.data = data;
+            str.capacity = capacity;
+        }
+        memcpy(str.data + str.size, chunk, n);
+        str.size += n;
+        str.data[str.size] = '\0';
+        return 0;
+    }
+};
+
+template <typename Func>
+static const char* dump_json(AnalysisState& state, Func func) {
+    DumpString str;
+    DumpSink sink {&DumpString::append, &str, -1};
+    if (stream_json(state, sink, func) != 0) {
+        error_exit("Error, ran out of memory while dumping the state!");
+    }
+    return str.data;
 }
 
 struct TweetApiProxy {
-    Tweet tweet;
+    Tweet* tweet;
     template <typename Archive>
     void serialize(Archive& ar) {
-        tweet.api_serialize(ar);
+        tweet->api_serialize(ar);
     }
 };
  
@@ -155,47 +235,126 @@ struct AgentApiProxy {
     }
 };
 
-extern "C" {
-const char* hashkat_dump_summary(AnalysisState* state) {
-    stringstream output;
-    JsonWriter writer {*state, output};
-    auto n_agents = state->network.size();
-    vector<vector<int>> follower_sets;
-    vector<vector<int>> following_sets;
-    for (Agent& agent : state->network) {
-        follower_sets.push_back(agent.follower_set.as_vector());
-        following_sets.push_back(agent.following_set.as_vector());
+// The live tweets, written straight from the tweet bank:
+struct LiveTweetsProxy {
+    TweetBank* tweet_bank;
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        auto nodes = tweet_bank->as_node_vector();
+        ar(cereal::make_size_tag(nodes.size()));
+        for (auto* node : nodes) {
+            TweetApiProxy proxy {&node->data};
+            ar(proxy);
+        }
     }
+};
 
-    vector<TweetApiProxy> live_tweets;
-    for (auto& t : state->tweet_bank.as_vector()) {
-        live_tweets.push_back({t});
+// Every agent's follower or following set, written straight from the sets:
+template <typename FollowSet>
+struct FollowSetProxy {
+    FollowSet* set;
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_size_tag(set->size()));
+        set->for_each([&](int id) {
+            ar(id);
+        });
     }
-    writer(NVP(live_tweets), NVP(n_agents), 
-        NVP(follower_sets), NVP(following_sets));
-    string output_str = output.str();
-    return copy_str(output_str.c_str(), output_str.size());
+};
+
+struct FollowSetsProxy {
+    Network* network;
+    bool followers;
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_size_tag((size_t)network->size()));
+        for (Agent& agent : *network) {
+            if (followers) {
+                FollowSetProxy<FollowerSet> proxy {&agent.follower_set()};
+                ar(proxy);
+            } else {
+                FollowSetProxy<FollowingSet> proxy {&agent.following_set()};
+                ar(proxy);
+            }
+        }
+    }
+};
+
+static void write_stats(JsonWriter& writer) {
+    AnalysisState& state = writer.state;
+    double time = state.time;
+    int n_agents = state.network.size();
+    state.stats.serialize(writer);
+    writer(NVP(time), NVP(n_agents));
 }
 
-const char* hashkat_dump_tweet(AnalysisState* state, Tweet* tweet) {
-    stringstream output;
-    JsonWriter writer {*state, output};
-    tweet->api_serialize(writer);
-    string output_str = output.str();
-    return copy_str(output_str.c_str(), output_str.size());
+static void write_state(JsonWriter& writer) {
+    writer.state.serialize(writer);
 }
 
-const char* hashkat_dump_agents(AnalysisState* state, int dump_follow_sets) {
-    stringstream output;
-    JsonWriter writer {*state, output};
-    auto n_agents = state->network.size();
+static void write_summary(JsonWriter& writer) {
+    AnalysisState& state = writer.state;
+    auto n_agents = state.network.size();
+    LiveTweetsProxy live_tweets {&state.tweet_bank};
+    FollowSetsProxy follower_sets {&state.network, true};
+    FollowSetsProxy following_sets {&state.network, false};
+    writer(NVP(live_tweets), NVP(n_agents),
+        NVP(follower_sets), NVP(following_sets));
+}
+
+static void write_agents(JsonWriter& writer, bool dump_follow_sets) {
+    auto n_agents = writer.state.network.size();
     writer( cereal::make_size_tag(n_agents));
-    for (Agent& agent : state->network) {
-        AgentApiProxy proxy {&agent, dump_follow_sets != 0};
+    for (Agent& agent : writer.state.network) {
+        AgentApiProxy proxy {&agent, dump_follow_sets};
         writer(proxy);
     }
-    string output_str = output.str();
-    return copy_str(output_str.c_str(), output_str.size());
 }
+
+extern "C" {
+const char* hashkat_dump_stats(AnalysisState* state) { 
+    return dump_json(*state, write_stats);
 }
 
+const char* hashkat_dump_state(AnalysisState* state) { 
+    return dump_json(*state, write_state);
+}
+
+const char* hashkat_dump_summary(AnalysisState* state) {
+    return dump_json(*state, write_summary);
+}
+
+const char* hashkat_dump_tweet(AnalysisState* state, Tweet* tweet) {
+    return dump_json(*state, [&](JsonWriter& writer) {
+        tweet->api_serialize(writer);
+    });
+}
+
+const char* hashkat_dump_agents(AnalysisState* state, int dump_follow_sets) {
+    return dump_json(*state, [&](JsonWriter& writer) {
+        write_agents(writer, dump_follow_sets != 0);
+    });
+}
+
+void hashkat_dump_free(struct AnalysisState* state, const char* dump) {
+    free((void*)dump);
+}
+
+int hashkat_stream_state(AnalysisState* state, DumpSink* sink) {
+    return stream_json(*state, *sink, write_state);
+}
+
+int hashkat_stream_stats(AnalysisState* state, DumpSink* sink) {
+    return stream_json(*state, *sink, write_stats);
+}
+
+int hashkat_stream_agents(AnalysisState* state, int dump_follow_sets, DumpSink* sink) {
+    return stream_json(*state, *sink, [&](JsonWriter& writer) {
+        write_agents(writer, dump_follow_sets != 0);
+    });
+}
+
+int hashkat_stream_summary(AnalysisState* state, DumpSink* sink) {
+    return stream_json(*state, *sink, write_summary);
+}
+}
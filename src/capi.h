@@ -25,6 +25,8 @@
 #ifndef CAPI_H_
 #define CAPI_H_
 
+#include <stddef.h>
+
 /* Should only be included with 'extern "C"' around it. 
  * This file is consumed by bindings.py (which doesn't understand 'extern "C"'). */
 
@@ -56,5 +58,22 @@ const char* hashkat_dump_agents(struct AnalysisState* state, int dump_follow_set
 const char* hashkat_dump_summary(struct AnalysisState* state);
 void hashkat_dump_free(struct AnalysisState* state, const char* dump);
 
+// Where the hashkat_stream_* functions write their JSON. Output is handed over in chunks
+// of at most 64KB, as it is formatted, so no dump is ever held whole in memory.
+struct DumpSink {
+    // Called with each chunk, if set. Returns nonzero to stop the dump.
+    int (*write_chunk)(void* context, const char* data, size_t size);
+    void* context;
+    // Otherwise, the file descriptor written to:
+    int fd;
+};
+
+// The same documents as the hashkat_dump_* functions. Return 0 on success, -1 if a write
+// failed or was stopped.
+int hashkat_stream_state(struct AnalysisState* state, struct DumpSink* sink);
+int hashkat_stream_stats(struct AnalysisState* state, struct DumpSink* sink);
+int hashkat_stream_agents(struct AnalysisState* state, int dump_follow_sets, struct DumpSink* sink);
+int hashkat_stream_summary(struct AnalysisState* state, struct DumpSink* sink);
+
 // Test bindings:
 #endif /* CAPI_H_ */
@@ -79,6 +79,21 @@ static FollowModel parse_follow_model(const Node& node) {
     }
 }
 
+static OutputCompression parse_output_compression(const Node& node) {
+    string compression = "none";
+    parse_opt(node, "compression", compression);
+    if (compression == "none") {
+        return COMPRESS_NONE;
+    } else if (compression == "gzip") {
+        return COMPRESS_GZIP;
+    } else if (compression == "zstd") {
+        return COMPRESS_ZSTD;
+    } else {
+        throw YAML::RepresentationException(node.GetMark(),
+                format("'%s' is not a valid output compression!", compression.c_str()));
+    }
+}
+
 static vector<PreferenceClass> parse_preference_classes(const Node& node) {
     const Node& pref_classes = node["preference_classes"];
     vector<PreferenceClass> ret;
@@ -174,9 +189,20 @@ static void parse_analysis_configuration(ParsedConfig& config, const Node& node)
     parse(node, "unfollow_tweet_rate", config.unfollow_tweet_rate);
     parse(node, "stage1_unfollow", config.stage1_unfollow);
     parse(node, "use_hashtag_probability", config.hashtag_prob);
+    parse_opt(node, "hashtag_topics", config.hashtag_topics);
+    parse_opt(node, "hashtag_trend_halflife", config.hashtag_trend_halflife);
     parse(node, "use_barabasi", config.use_barabasi);
     parse(node, "barabasi_connections", config.barabasi_connections);
     parse(node, "barabasi_exponent", config.barabasi_exponent);
+    parse_opt(node, "use_bulk_initial_agents", config.use_bulk_initial_agents);
+    if (node.FindValue("initial_graph")) {
+        const Node& graph = node["initial_graph"];
+        parse(graph, "edges", config.initial_graph.edges);
+        parse_opt(graph, "agent_types", config.initial_graph.agent_types);
+        parse_opt(graph, "regions", config.initial_graph.regions);
+        parse_opt(graph, "languages", config.initial_graph.languages);
+        parse_opt(graph, "ideologies", config.initial_graph.ideologies);
+    }
     parse(node, "use_followback", config.use_followback);
     parse(node, "use_follow_via_retweets", config.use_follow_via_retweets);
     parse(node, "use_random_time_increment", config.use_random_time_increment);
@@ -215,6 +241,9 @@ static void parse_output_configuration(ParsedConfig& config, const Node& node) {
     parse(node, "load_network_on_startup", config.load_network_on_startup);
     parse(node, "ignore_load_config_check", config.ignore_load_config_check);
     parse(node, "save_file", config.save_file);
+    parse_opt(node, "checkpoint_interval", config.checkpoint_interval);
+    parse_opt(node, "checkpoint_fork", config.checkpoint_fork);
+    parse_opt(node, "checkpoint_max_forks", config.checkpoint_max_forks);
 
     parse(node, "degree_distributions", config.degree_distributions);
 
@@ -226,6 +255,8 @@ static void parse_output_configuration(ParsedConfig& config, const Node& node) {
     parse(node ,"categories_distro", config.categories_distro);
     parse(node ,"most_popular_tweet_content", config.most_popular_tweet_content);
     parse(node ,"tweet_info", config.tweet_info);
+    config.output_compression = parse_output_compression(node);
+    parse_opt(node, "graph_export", config.graph_export);
 }
 
 static CategoryGrouper parse_category_thresholds(const Node& node) {
@@ -302,11 +333,11 @@ void parse_category_weights(ParsedConfig& config, const Node& node, CategoryGrou
 static void parse_category_configurations(ParsedConfig& config, const Node& node) {
     ASSERT(!config.agent_types.empty(), "Must have agent types!");
     if (config.use_barabasi) {
-        // One category per potential agent:
+        // One category per potential agent, weighted by degree + 1.
+        // Barabasi follows apply barabasi_exponent through the PreferentialSampler instead:
         for (int i = 1; i < config.max_agents + 1; i ++) {
             CategoryAgentList cat(i-1, i);
             config.follow_ranks.categories.push_back(cat);
-            config.follow_probabilities.push_back(pow(i,config.barabasi_exponent));
             for (int j = 0; j < config.agent_types.size(); j++ ) {
                 AgentType& type = config.agent_types[j];
                 type.follow_ranks.categories.push_back(cat);
@@ -480,6 +511,21 @@ static void check_configuration_integrity(ParsedConfig& config) {
         printf("Cannot enable both query request mode and interactive mode!\n");
         throw "Error";
     }
+    const std::string snapshot_ext = ".snap";
+    if (config.checkpoint_interval > 0 && (config.save_file.size() < snapshot_ext.size()
+            || config.save_file.compare(config.save_file.size() - snapshot_ext.size(), snapshot_ext.size(), snapshot_ext) != 0)) {
+        printf("Checkpoints (output.checkpoint_interval) require a save_file ending in '.snap'!\n");
+        throw "Error";
+    }
+    if (!TextWriter::supports(config.output_compression)) {
+        printf("This build of #k@ cannot write output.compression '%s'; it was built without the library!\n",
+                config.output_compression == COMPRESS_GZIP ? "gzip" : "zstd");
+        throw "Error";
+    }
+    if (config.checkpoint_fork && config.checkpoint_max_forks < 1) {
+        printf("output.checkpoint_max_forks must be at least 1!\n");
+        throw "Error";
+    }
 }
 
 /***************************************************************************
@@ -573,3 +619,26 @@ ParsedConfig parse_yaml_configuration(const char* file_name) {
         throw;
     }
 }
+
+FollowerSetDims follower_set_dims(const ParsedConfig& config) {
+    FollowerSetDims dims;
+    dims.n_pref_classes = max<int>(1, config.pref_classes.size());
+    dims.n_regions = max<int>(1, config.regions.regions.size());
+    dims.n_ideologies = max<int>(1, config.ideologies.size());
+    // Only languages that can be assigned need a bin, usually far fewer than N_LANGS:
+    dims.n_langs = 1;
+    for (const Region& region : config.regions.regions) {
+        dims.n_pref_classes = max<int>(dims.n_pref_classes, region.preference_class_probs.size());
+        dims.n_ideologies = max<int>(dims.n_ideologies, region.ideology_probs.size());
+        for (int i = 0; i < region.language_probs.size(); i++) {
+            if (region.language_probs[i] > 0) {
+                dims.n_langs = max(dims.n_langs, i + 1);
+            }
+        }
+    }
+    // An imported graph may give any language:
+    if (!config.initial_graph.languages.empty()) {
+        dims.n_langs = N_LANGS;
+    }
+    return dims;
+}
@@ -31,6 +31,7 @@
 #include "events.h"
 
 #include "FollowerSet.h"
+#include "util/TextWriter.h"
 
 struct PreferenceClass {
     std::string name;
@@ -64,6 +65,18 @@ struct Regions {
     }
 };
 
+// Optional network to start from, instead of creating 'initial_agents'.
+// All files hold native-endian 32-bit integers, see docs/input.md.
+struct InitialGraphFiles {
+    std::string edges; // (follower, followed) pairs
+    // Optional columns with one entry per agent; empty if not given:
+    std::string agent_types, regions, languages, ideologies;
+
+    bool enabled() const {
+        return !edges.empty();
+    }
+};
+
 // Config variables, read from INFILE.yaml
 struct ParsedConfig {
     // Values here are just in lieu of garbage -- many of them are mandatory config variables.
@@ -88,6 +101,8 @@ struct ParsedConfig {
     bool use_susceptibility = false;
     
     int barabasi_connections = 1;
+    bool use_bulk_initial_agents = false;
+    InitialGraphFiles initial_graph;
     double barabasi_exponent = 1;
     
     bool agent_stats = false;
@@ -97,12 +112,19 @@ struct ParsedConfig {
     bool full_tweet_stats = false;
     bool stage1_unfollow = false;
     double hashtag_prob = 0;
+    int hashtag_topics = 1;
+    double hashtag_trend_halflife = 1440; // minutes
     FollowModel follow_model = RANDOM_FOLLOW;
     std::vector<double> model_weights;
 
     bool save_network_on_timeout = false, load_network_on_startup = false;
     bool ignore_load_config_check = false;
     std::string save_file;
+    // Real minutes between checkpoints to 'save_file', 0 for none.
+    double checkpoint_interval = 0;
+    // Write checkpoints from a forked child, with at most 'checkpoint_max_forks' at once.
+    bool checkpoint_fork = false;
+    int checkpoint_max_forks = 1;
     std::string lua_script = "INTERACT.lua";
 
     // 'rates' config options
@@ -122,6 +144,10 @@ struct ParsedConfig {
     bool categories_distro = false;
     bool most_popular_tweet_content = false;
     bool tweet_info = false;
+    // For the large text outputs (network.dat, network.gexf, network.graphml, tweet_info.dat):
+    OutputCompression output_compression = COMPRESS_NONE;
+    // Export the final and monthly graphs as .npy arrays, see export_graph.
+    bool graph_export = false;
 
     // 'X_category' config options
 
@@ -130,7 +156,6 @@ struct ParsedConfig {
     CategoryGrouper retweet_ranks;
     Rate_Function referral_rate_function;
 
-    std::vector<double> follow_probabilities;
     Regions regions;
     // 'agents' config options
     // Note: Weights are filled, agent lists empty
@@ -163,4 +188,7 @@ struct ParsedConfig {
 
 ParsedConfig parse_yaml_configuration(const char* file_name);
 
+// The bins agents can take in each follower set layer, under 'config'.
+FollowerSetDims follower_set_dims(const ParsedConfig& config);
+
 #endif
@@ -88,7 +88,8 @@ void PerfTimer::clear() {
 	perf_map.clear();
 }
 
-static PerfTimer __global_timer;
+// Per-thread, so that timed code may run on worker threads; results are those of the calling thread.
+static thread_local PerfTimer __global_timer;
 
 void perf_timer_begin(const char* funcname) {
 	__global_timer.begin(funcname);
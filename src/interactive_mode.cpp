@@ -175,13 +175,13 @@ struct InteractiveModeBindings {
         value["agent_type"] = state.state->agent_types[e.agent_type].name;
         DUMP(e, preference_class);
         DUMP(e, region_bin);
-        DUMP(e, ideology_tweet_percent);
+        value["ideology_tweet_percent"] = e.details().ideology_tweet_percent;
         DUMP(e, ideology_bin);
         DUMP(e, n_tweets);
         DUMP(e, n_retweets);
         DUMP(e, creation_time);
-        DUMP(e, avg_chatiness);
-        DUMP(e, chatty_agents);
+        value["avg_chatiness"] = e.details().avg_chatiness;
+        value["chatty_agents"] = e.details().chatty_agents;
 
         auto table = LuaValue::newtable(state.L);
         value["location"] = table;
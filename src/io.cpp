@@ -53,7 +53,11 @@
 #include <iomanip>
 #include <set>
 #include <cstdio>
+#include <sstream>
 #include <algorithm>
+#include <functional>
+#include <cerrno>
+#include <sys/stat.h>
 
 #include "dependencies/mtwist.h"
 #include "analyzer.h"
@@ -63,10 +67,16 @@
 #include "config_static.h"
 
 #include "util/StatCalc.h"
+#include "util/ParallelFor.h"
+#include "util/TextWriter.h"
+#include "util/NpyFile.h"
+#include "dependencies/lcommon/Timer.h"
 
 using namespace std;
 
 
+static void whos_following_who(AgentTypeVector& types, AgentType& type, const NetworkSweep::TypeStats& type_stats);
+
 // ROOT OUTPUT ROUTINE
 // After 'analyze', print the results of the computations.
 
@@ -105,16 +115,28 @@ void output_network_statistics(AnalysisState& state) {
     double rate_add = C.rate_add;
     int initial_agents = C.initial_agents;
 
-    // Depending on our INFILE/configuration, we may output various analysis
+    // The statistics over every agent and edge are gathered for all reports at once:
+    NetworkSweep sweep;
+    sweep.degrees = C.degree_distributions;
+    sweep.agent_types = C.agent_stats;
+    sweep.regions = C.region_connection_matrix;
+    sweep.follow_methods = C.dd_by_follow_model;
+    sweep.tweets = C.output_tweet_analysis;
+    sweep_network(network, state, sweep);
+
+    // Depending on our INFILE/configuration, we may output various analysis.
+    // Each report only reads the final state and writes its own files, so they are run concurrently on the
+    // thread pool. A report's own agent loops (see PARALLEL HELPERS) only take on the workers left idle.
+    vector<function<void()>> reports;
     if (C.output_visualize) {
-        output_position(network);
+        reports.push_back([&]() {output_position(network, C.output_compression);});
     }
     /* ADD FUNCTIONS THAT RUN AFTER NETWORK IS BUILT HERE */
     if (C.categories_distro) {
-        Categories_Check(state.tweet_ranks, state.follow_ranks, state.retweet_ranks);
+        reports.push_back([&]() {Categories_Check(state.tweet_ranks, state.follow_ranks, state.retweet_ranks);});
     }
     if (C.output_tweet_analysis) {
-        tweets_distribution(network);
+        reports.push_back([&]() {tweets_distribution(sweep);});
     }
     // Better to manually check distributions, for low network sizes this will most likely throw an error
     /*if (agent_checks(et_vec, network, state, state.config.add_rates, initial_agents)) {
@@ -123,30 +145,29 @@ void output_network_statistics(AnalysisState& state) {
         cout << "Numbers are events are not valid, adjust the tolerance or check for errors.\n";
     }*/
     if (C.agent_stats) {
-        whos_following_who(et_vec, network);
-    }
-    if (C.output_stdout_basic) {
-        cout << "Analysis complete!\n";
+        for (int i = 0; i < et_vec.size(); i++) {
+            reports.push_back([&, i]() {whos_following_who(et_vec, et_vec[i], sweep.types[i]);});
+        }
     }
     if (C.degree_distributions) {
-        degree_distributions(network, state);
+        reports.push_back([&]() {degree_distributions(state, sweep);});
     }
     if (C.retweet_viz) {
-        visualize_most_popular_tweet(mpt, network);
+        reports.push_back([&]() {visualize_most_popular_tweet(mpt, network);});
     }
     if (C.main_stats) {
-        network_statistics(network, stats, et_vec);
+        reports.push_back([&]() {network_statistics(network, stats, et_vec);});
     }
     // Only output tweet data files if they were collected
     // during execution:
     if (C.full_tweet_stats) {
-        tweet_info(old_tweets);
+        reports.push_back([&]() {tweet_info(old_tweets, C.output_compression);});
     }
     if (C.region_connection_matrix) {
-        region_stats(network, state);
+        reports.push_back([&]() {region_stats(state, sweep);});
     }
     if (C.most_popular_tweet_content) {
-        most_popular_tweet_content(mpt, network);
+        reports.push_back([&]() {most_popular_tweet_content(mpt, network);});
     }
     // cout << "\n\n\n\n\n\n\n";
     // print_n_agents_in_regions(network, state);
@@ -160,13 +181,254 @@ void output_network_statistics(AnalysisState& state) {
     //   dd_by_agent(network, state, stats);
     //}
     if (C.dd_by_follow_model) {
-        dd_by_follow_method(network, state, stats);
-    }   
+        reports.push_back([&]() {dd_by_follow_method(sweep);});
+    }
+    if (C.graph_export) {
+        reports.push_back([&]() {export_graph(state, "graph_final");});
+    }
+    parallel_for(reports.size(), [&](int i) {
+        reports[i]();
+    });
+    if (C.output_stdout_basic) {
+        cout << "Analysis complete!\n";
+    }
+}
+
+// PARALLEL HELPERS
+// The heavier reports loop over every agent and its edges. These loops are split into chunks of
+// agents, spread over the threads, and their results combined in agent order, so that the files
+// are identical to those of a serial loop.
+
+static const int REPORT_CHUNK_SIZE = 4096;
+
+// Run 'func(chunk, begin, end)' for each chunk [begin, end) of the agents [0, n_agents).
+template <typename Func>
+static void for_each_agent_chunk(int n_agents, int chunk_size, Func func) {
+    int n_chunks = (n_agents + chunk_size - 1) / chunk_size;
+    parallel_for(n_chunks, [&](int chunk) {
+        int begin = chunk * chunk_size;
+        func(chunk, begin, min(begin + chunk_size, n_agents));
+    });
+}
+
+// Write what 'format(id, out)' prints for each agent, in agent order. The text is made in parallel,
+// a batch of chunks at a time, so only one batch of it is held in memory.
+template <typename Format>
+static void write_per_agent(TextWriter& output, int n_agents, Format format) {
+    const int CHUNKS_PER_BATCH = 64;
+    const int BATCH_SIZE = CHUNKS_PER_BATCH * REPORT_CHUNK_SIZE;
+    vector<string> texts(CHUNKS_PER_BATCH);
+    for (int first = 0; first < n_agents; first += BATCH_SIZE) {
+        int batch_end = min(first + BATCH_SIZE, n_agents);
+        for_each_agent_chunk(batch_end - first, REPORT_CHUNK_SIZE, [&](int chunk, int begin, int end) {
+            TextWriter out;
+            for (int id = first + begin; id < first + end; id++) {
+                format(id, out);
+            }
+            texts[chunk] = out.take_text();
+        });
+        for (int chunk = 0; chunk * REPORT_CHUNK_SIZE < batch_end - first; chunk++) {
+            output << texts[chunk];
+        }
+    }
+}
+
+// NETWORK SWEEP
+// One pass over the agents and their edges, gathering what the enabled reports need.
+
+static void count(vector<int>& histogram, int value) {
+    if (histogram.size() <= value) {
+        histogram.resize(value + 1, 0);
+    }
+    histogram[value]++;
+}
+
+static void add_counts(vector<int>& into, const vector<int>& counts) {
+    if (into.size() < counts.size()) {
+        into.resize(counts.size(), 0);
+    }
+    for (int i = 0; i < counts.size(); i++) {
+        into[i] += counts[i];
+    }
+}
+
+// 'count_degrees' is false when the degree histograms are taken from DegreeHistograms instead.
+static void sweep_agent(Network& network, Agent& e, NetworkSweep& sweep, bool count_degrees) {
+    int out_degree = e.following_set().size(), in_degree = e.follower_set().size();
+    if (sweep.degrees && count_degrees) {
+        count(sweep.out_degrees, out_degree);
+        count(sweep.in_degrees, in_degree);
+        count(sweep.total_degrees, in_degree + out_degree);
+    }
+    NetworkSweep::TypeStats* type = sweep.agent_types ? &sweep.types[e.agent_type] : NULL;
+    if (type != NULL) {
+        if (count_degrees) {
+            count(type->out_degrees, out_degree);
+            count(type->in_degrees, in_degree);
+            count(type->total_degrees, in_degree + out_degree);
+        }
+        type->n_followers += in_degree;
+        type->n_followings += out_degree;
+        e.follower_set().for_each([&](int id_fol) {
+            type->follower_types[network[id_fol].agent_type]++;
+        });
+    }
+    if (type != NULL || sweep.regions) {
+        int* connections = sweep.regions ? &sweep.region_connections[e.region_bin * N_BIN_REGIONS] : NULL;
+        e.following_set().for_each([&](int id_followed) {
+            Agent& followed = network[id_followed];
+            if (type != NULL) {
+                type->followed_types[followed.agent_type]++;
+            }
+            if (connections != NULL) {
+                connections[followed.region_bin]++;
+            }
+        });
+    }
+    if (sweep.follow_methods) {
+        for (int i = 0; i < N_FOLLOW_MODELS; i++) {
+            count(sweep.follow_method_degrees[i], e.details().following_method_counts[i] + e.details().follower_method_counts[i]);
+        }
+    }
+    if (sweep.tweets) {
+        count(sweep.tweet_counts, e.n_tweets);
+        count(sweep.retweet_counts, e.n_retweets);
+    }
+    if (sweep.attributes) {
+        sweep.languages[e.language]++;
+        sweep.ideologies[e.ideology_bin]++;
+        sweep.region_bins[e.region_bin]++;
+        sweep.preference_classes[e.preference_class]++;
+        sweep.follower_stats.add_element(in_degree);
+        sweep.following_stats.add_element(out_degree);
+        sweep.tweet_stats.add_element(e.n_tweets);
+        sweep.retweet_stats.add_element(e.n_retweets);
+    }
+}
+
+// Size the fixed-size parts of a sweep for 'n_types' agent types.
+static void size_sweep(NetworkSweep& sweep, int n_types) {
+    if (sweep.agent_types) {
+        NetworkSweep::TypeStats type;
+        type.follower_types.resize(n_types, 0);
+        type.followed_types.resize(n_types, 0);
+        sweep.types.resize(n_types, type);
+    }
+    if (sweep.regions) {
+        sweep.region_connections.resize(N_BIN_REGIONS * N_BIN_REGIONS, 0);
+    }
+    if (sweep.attributes) {
+        sweep.languages.resize(N_LANGS, 0);
+        sweep.ideologies.resize(N_BIN_IDEOLOGIES, 0);
+        sweep.region_bins.resize(N_BIN_REGIONS, 0);
+        sweep.preference_classes.resize(N_BIN_PREFERENCE_CLASS, 0);
+    }
+}
+
+static void merge_sweep(NetworkSweep& into, const NetworkSweep& part) {
+    add_counts(into.out_degrees, part.out_degrees);
+    add_counts(into.in_degrees, part.in_degrees);
+    add_counts(into.total_degrees, part.total_degrees);
+    for (int i = 0; i < into.types.size(); i++) {
+        NetworkSweep::TypeStats& type = into.types[i];
+        const NetworkSweep::TypeStats& part_type = part.types[i];
+        add_counts(type.out_degrees, part_type.out_degrees);
+        add_counts(type.in_degrees, part_type.in_degrees);
+        add_counts(type.total_degrees, part_type.total_degrees);
+        add_counts(type.follower_types, part_type.follower_types);
+        add_counts(type.followed_types, part_type.followed_types);
+        type.n_followers += part_type.n_followers;
+        type.n_followings += part_type.n_followings;
+    }
+    add_counts(into.region_connections, part.region_connections);
+    for (int i = 0; i < N_FOLLOW_MODELS; i++) {
+        add_counts(into.follow_method_degrees[i], part.follow_method_degrees[i]);
+    }
+    add_counts(into.tweet_counts, part.tweet_counts);
+    add_counts(into.retweet_counts, part.retweet_counts);
+    add_counts(into.languages, part.languages);
+    add_counts(into.ideologies, part.ideologies);
+    add_counts(into.region_bins, part.region_bins);
+    add_counts(into.preference_classes, part.preference_classes);
+    into.follower_stats.merge(part.follower_stats);
+    into.following_stats.merge(part.following_stats);
+    into.tweet_stats.merge(part.tweet_stats);
+    into.retweet_stats.merge(part.retweet_stats);
+}
+
+static void sweep_agents(Network& network, NetworkSweep& sweep, bool count_degrees) {
+    // Each chunk of agents is swept into its own partial result. They are merged in chunk order,
+    // so that the (floating point) summaries do not depend on the thread timing.
+    const int MAX_PARTS = 256;
+    int chunk_size = max(REPORT_CHUNK_SIZE, (sweep.n_agents + MAX_PARTS - 1) / MAX_PARTS);
+    NetworkSweep empty = sweep;
+    vector<NetworkSweep> parts((sweep.n_agents + chunk_size - 1) / chunk_size, empty);
+    for_each_agent_chunk(sweep.n_agents, chunk_size, [&](int chunk, int begin, int end) {
+        for (int id = begin; id < end; id++) {
+            sweep_agent(network, network[id], parts[chunk], count_degrees);
+        }
+    });
+    for (NetworkSweep& part : parts) {
+        merge_sweep(sweep, part);
+    }
+}
+
+// The histograms kept by 'histograms', as a sweep counts them: up to the highest degree present.
+static void take_degree_histograms(NetworkSweep& sweep, const DegreeHistograms& histograms) {
+    auto trimmed = [](const vector<int>& histogram) {
+        int size = histogram.size();
+        while (size > 0 && histogram[size - 1] == 0) {
+            size--;
+        }
+        return vector<int>(histogram.begin(), histogram.begin() + size);
+    };
+    if (sweep.degrees) {
+        sweep.out_degrees = trimmed(histograms.all.out_degrees);
+        sweep.in_degrees = trimmed(histograms.all.in_degrees);
+        sweep.total_degrees = trimmed(histograms.all.total_degrees);
+    }
+    for (int i = 0; i < sweep.types.size(); i++) {
+        sweep.types[i].out_degrees = trimmed(histograms.types[i].out_degrees);
+        sweep.types[i].in_degrees = trimmed(histograms.types[i].in_degrees);
+        sweep.types[i].total_degrees = trimmed(histograms.types[i].total_degrees);
+    }
+}
+
+void sweep_network(Network& network, AnalysisState& state, NetworkSweep& sweep) {
+    PERF_TIMER();
+    sweep.n_agents = network.size();
+    size_sweep(sweep, state.agent_types.size());
+    const DegreeHistograms& histograms = state.degree_histograms;
+    bool count_degrees = !histograms.enabled;
+    DEBUG_CHECK(count_degrees || histograms.n_agents() == sweep.n_agents, "Degree histograms out of sync with the network!");
+    // With the degrees at hand, only the other groups need a pass over the agents:
+    if ((sweep.degrees && count_degrees) || sweep.agent_types || sweep.regions || sweep.follow_methods || sweep.tweets || sweep.attributes) {
+        sweep_agents(network, sweep, count_degrees);
+    }
+    if (!count_degrees) {
+        take_degree_histograms(sweep, histograms);
+    }
+}
+
+// MEMORY REPORT
+// Breakdown of the memory held by each subsystem, see analyzer_memory_usage.
+
+void print_memory_report(AnalysisState& state) {
+    const double MB = 1024.0 * 1024.0;
+    MemoryUsage memory = analyzer_memory_usage(state);
+    double total = memory.total();
+    printf("**** MEMORY USAGE (%d agents, %d active tweets) ****\n", state.network.size(), state.tweet_bank.n_active_tweets());
+    memory.for_each([&](const char* name, size_t bytes) {
+        printf("%-20s %12.2f MB  (%5.1f%%)\n", name, bytes / MB, total > 0 ? 100.0 * bytes / total : 0.0);
+    });
+    printf("%-20s %12.2f MB\n", "Total (accounted)", total / MB);
+    printf("%-20s %12.2f MB\n", "Peak resident", memory.peak_resident / MB);
+    printf("**** END MEMORY USAGE ****\n");
 }
 
 // TWEET_INFO_DAT
 
-void tweet_info(vector<Tweet>& old_tweets) {
+void tweet_info(vector<Tweet>& old_tweets, OutputCompression compression) {
 
     std::vector<int> authors;
     std::vector<int> content;
@@ -174,7 +436,8 @@ void tweet_info(vector<Tweet>& old_tweets) {
     std::vector<int> popular_agent;
     std::vector<int> tweet_generation;
     double average_time_retweeted = 0, average_tweet_lifetime = 0;
-    ofstream output1, output2;
+    ofstream output1;
+    TextWriter output2;
     output1.open("output/average_tweet_info.dat");
     output1 << "#Contains network information about tweets in the simulation.\n#Generation = length of longest path tweeter -> recipient\n#Generation 0 = original/root, 1 = retweeted one level, 2 = retweeted 2 levels\n\n";
     for (auto& tweet : old_tweets) {
@@ -231,26 +494,27 @@ void tweet_info(vector<Tweet>& old_tweets) {
 
     output1.close();
 
-    output2.open("output/tweet_info.dat");
+    output2.open("output/tweet_info.dat", compression);
+    const TextWriter::Pad COLUMN = TextWriter::pad(25);
 
     output2 << "#Contains basic information relating to every tweet and retweet within the network simulation.\n\n"
-            << "Tweet ID\t" << setw(25)
-            << "Author ID\t" << setw(25)
-            << "Tweet Content\t" << setw(25)
-            << "Hashtag Presence\t" << setw(25)
-            << "Retweeted From Agent\t" << setw(25)
-            << "Tweet Generation\t" << setw(25)
-            << "Number of Times Retweeted\t" << setw(25)
+            << "Tweet ID\t" << COLUMN
+            << "Author ID\t" << COLUMN
+            << "Tweet Content\t" << COLUMN
+            << "Hashtag Presence\t" << COLUMN
+            << "Retweeted From Agent\t" << COLUMN
+            << "Tweet Generation\t" << COLUMN
+            << "Number of Times Retweeted\t" << COLUMN
             << "Tweet Lifetime (minutes)\n\n";
 
     for (auto& tweet : old_tweets) {
-        output2 << tweet.id_tweet << "\t" << setw(25)
-                << tweet.id_tweeter << "\t" << setw(25)
-                << tweet.content->type << "\t" << setw(25)
-                << tweet.hashtag << "\t" << setw(25)
-                << tweet.id_link << "\t" << setw(25)
-                << tweet.generation << "\t" << setw(25)
-                << tweet.content->used_agents.size() << "\t" << setw(25)
+        output2 << tweet.id_tweet << "\t" << COLUMN
+                << tweet.id_tweeter << "\t" << COLUMN
+                << tweet.content->type << "\t" << COLUMN
+                << tweet.hashtag << "\t" << COLUMN
+                << tweet.id_link << "\t" << COLUMN
+                << tweet.generation << "\t" << COLUMN
+                << tweet.content->used_agents.size() << "\t" << COLUMN
                 << tweet.deletion_time - tweet.creation_time << "\n";
     }
     output2.close();
@@ -261,6 +525,15 @@ static void output_stat_calc(const char* name, StatCalc& calc) {
     cout << "Average " << name << ": " << calc.average << " (+-" << calc.standard_deviation() << ")" << endl;
 }
 
+static DiscreteDist discrete_dist(const vector<int>& bins, int n_elements) {
+    DiscreteDist dist;
+    for (int i = 0; i < bins.size(); i++) {
+        dist.totals[i] = bins[i];
+    }
+    dist.n_elements = n_elements;
+    return dist;
+}
+
 void brief_agent_statistics(AnalysisState& state) {
     Network& network = state.network;
     ParsedConfig& config = state.config;
@@ -273,24 +546,20 @@ void brief_agent_statistics(AnalysisState& state) {
        printf("(Agent %d)\n", i);
        printf("(AgentType %s)\n", et.name.c_str());
        printf("------------------------------------------------------------------------\n");
-       e.follower_set.print();
+       e.follower_set().print();
     }
 
-    DiscreteDist langs, ideos, regions, prefs;
-    StatCalc follows, followers, tweets, retweets;
-    for (Agent& e : network) {
-        // Discrete options:
-        langs.add_element(e.language);
-        ideos.add_element(e.ideology_bin);
-        regions.add_element(e.region_bin);
-        prefs.add_element(e.preference_class);
-
-        // General statistics:
-        follows.add_element(e.follower_set.size());
-        followers.add_element(e.following_set.size());
-        tweets.add_element(e.n_tweets);
-        retweets.add_element(e.n_retweets);
-    }
+    NetworkSweep sweep;
+    sweep.attributes = true;
+    sweep_network(network, state, sweep);
+    // Discrete options:
+    DiscreteDist langs = discrete_dist(sweep.languages, sweep.n_agents);
+    DiscreteDist ideos = discrete_dist(sweep.ideologies, sweep.n_agents);
+    // General statistics:
+    StatCalc& follows = sweep.follower_stats;
+    StatCalc& followers = sweep.following_stats;
+    StatCalc& tweets = sweep.tweet_stats;
+    StatCalc& retweets = sweep.retweet_stats;
 
     cout << "Language statistics:" << endl;
     for (int i = 0; i < N_LANGS; i++) {
@@ -336,11 +605,11 @@ void brief_agent_statistics(AnalysisState& state) {
 
 // NETWORK.GEXF edgelist for R (analysis), python executable (drawing), and gephi output file
 
-void output_position(Network& network) {
+void output_position(Network& network, OutputCompression compression) {
     static const int OUTPUT_THRESHOLD = 10000;
     int n_agents = network.size();
-    ofstream output1;
-    output1.open("output/network.gexf");
+    TextWriter output1;
+    output1.open("output/network.gexf", compression);
     output1 << "<gexf version=\"1.2\">\n"
             << "<meta lastmodifieddate=\"2013-11-21\">\n"
             << "<creator> Kevin Ryczko </creator>\n"
@@ -398,20 +667,20 @@ void output_position(Network& network) {
 
 // NETWORK.DAT
 
-    ofstream output;
-    output.open("output/network.dat");
+    TextWriter output;
+    output.open("output/network.dat", compression);
     output << "# Agent ID\tFollower ID\n\n";
-    for (int id = 0; id < n_agents; id++) {
+    write_per_agent(output, n_agents, [&](int id, TextWriter& out) {
         for (int id_fol : network.follower_set(id).as_vector()) {
-            output << id << "\t\t" << id_fol << "\n";
+            out << id << "\t\t" << id_fol << "\n";
         }
-    }
+    });
     output.close();
 
 // NETWORK.GRAPHML
 
-    ofstream output2;
-    output2.open("output/network.graphml");
+    TextWriter output2;
+    output2.open("output/network.graphml", compression);
     output2 << "# File used to graph the network, where 'nodes' correspond to agents in the network and 'edges' correspond to connections.\n\n";
     int count2 = 0;
     if (n_agents <= 10000) {
@@ -434,12 +703,7 @@ void output_position(Network& network) {
 
 // MODEL_MATCH.DAT
 
-void model_match(Network& network, vector<int> & counts, int max_degree) {
-    int sum_k = 0;
-    for (int i = 0; i < network.size(); i++) {
-       sum_k += network.n_followers(i);
-       sum_k += network.n_followings(i); 
-    }
+void model_match(vector<int> & counts, int max_degree) {
     double sum_jN = 0;
     for (int j = 0; j < counts.size(); j++) {
         sum_jN += j*counts[j];
@@ -469,16 +733,10 @@ void model_match(Network& network, vector<int> & counts, int max_degree) {
 
 // DEGREE_DISTRIBUTION.DAT  IN-OUT-CULMULATIVE
 
-void degree_distributions(Network& network,AnalysisState& state) {
-    int max_following = 0, max_followers = 0;
-    for (int i = 0; i < network.size(); i++) {
-        if (network.n_followings(i) >= max_following) {
-            max_following = network.n_followings(i) + 1;
-        }
-        if (network.n_followers(i) >= max_followers) {
-            max_followers = network.n_followers(i) + 1;
-        }
-    }
+void degree_distributions(AnalysisState& state, const NetworkSweep& sweep) {
+    // One past the highest degree:
+    int max_following = sweep.out_degrees.size(), max_followers = sweep.in_degrees.size();
+    double n_agents = sweep.n_agents;
 
     int max_degree = max_following + max_followers;
 
@@ -504,25 +762,10 @@ void degree_distributions(Network& network,AnalysisState& state) {
     cumuldd << "# This is the cumulative degree distribution. The data order is:\n# degree, normalized probability, log of degree, log of normalized probability\n\n#d\tn.prob\tlog_d\tlog_np\n\n";
     //scaled << "# This is the scaled degree distribution. The data order is:\n# degree, normalized probability, log of degree, log of normalized probability\n\n#d\tn.prob\tlog_d\tlog_np\n\n";
 
-    //declare and set arrays to 0
-    vector<int> out_degree_distro (max_following);
-    vector<int> in_degree_distro (max_followers);
-    vector<int> cumulative_distro (max_degree);
-    for (int i = 0; i < max_following; i ++ ) {
-        out_degree_distro[i] = 0;
-    }
-    for (int i = 0; i < max_followers; i ++ ) {
-        in_degree_distro[i] = 0;
-    }
-    for (int i = 0; i < max_degree; i ++ ) {
-        cumulative_distro[i] = 0;
-    }
-    //go through network and generate distributions
-    for (int i = 0; i < network.size(); i++) {
-        out_degree_distro[network.n_followings(i)] ++;
-        in_degree_distro[network.n_followers(i)] ++;
-        cumulative_distro[network.n_followers(i) + network.n_followings(i)] ++;
-    }
+    const vector<int>& out_degree_distro = sweep.out_degrees;
+    const vector<int>& in_degree_distro = sweep.in_degrees;
+    vector<int> cumulative_distro = sweep.total_degrees;
+    cumulative_distro.resize(max_degree, 0);
     
     double max = 0;
     for (auto& count : cumulative_distro) {
@@ -531,16 +774,16 @@ void degree_distributions(Network& network,AnalysisState& state) {
         }
     }
     
-    model_match(network, cumulative_distro, max_degree);
+    model_match(cumulative_distro, max_degree);
     // output the distributions
     for (int i = 0; i < max_following; i ++) {
-        outdd << i << "\t" << out_degree_distro[i] / (double)network.size() << "\t" << log(i) << "\t" << log(out_degree_distro[i] / (double)network.size()) << "\n";
+        outdd << i << "\t" << out_degree_distro[i] / n_agents << "\t" << log(i) << "\t" << log(out_degree_distro[i] / n_agents) << "\n";
     }
     for (int i = 0; i < max_followers; i ++) {
-        indd << i << "\t" << in_degree_distro[i] / (double)network.size() << "\t" << log(i) << "\t" << log(in_degree_distro[i] / (double)network.size()) << "\n";
+        indd << i << "\t" << in_degree_distro[i] / n_agents << "\t" << log(i) << "\t" << log(in_degree_distro[i] / n_agents) << "\n";
     }
     for (int i = 0; i < max_degree; i ++) {
-        cumuldd << i << "\t" << cumulative_distro[i] / (double)network.size() << "\t" << log(i) << "\t" << log(cumulative_distro[i] / (double)network.size()) << "\n";
+        cumuldd << i << "\t" << cumulative_distro[i] / n_agents << "\t" << log(i) << "\t" << log(cumulative_distro[i] / n_agents) << "\n";
     }
     //for (int i = 0; i < max_degree; i ++) {
      //   scaled << i / (double) max_degree << "\t" << cumulative_distro[i] / (double) max << "\t" << log(i / (double) max_degree) << "\t" << log(cumulative_distro[i] / (double) max) << "\n";
@@ -596,7 +839,7 @@ void agent_statistics(Network& network, int n_follows, int n_agents, int max_age
         for (int j = 0; j < max_agents; j ++) {
             if (p.agent_type == j) {
                 agent_counts[j] ++;
-                average_followers_from_network[j] += p.follower_set.size();
+                average_followers_from_network[j] += p.follower_set().size();
             }
         }
     }
@@ -621,7 +864,7 @@ void agent_statistics(Network& network, int n_follows, int n_agents, int max_age
     for (int i = 0; i < max_agents; i ++){
         for (int j = 0; j < agenttype[i].agents.agent_ids.size(); j++) {
             Agent& p = network[agenttype[i].agents.agent_ids[j]];
-            average_followers_from_lists[i] += p.follower_set.size();
+            average_followers_from_lists[i] += p.follower_set().size();
         }
     }
     output << "\n\n ****** Info regarding following certain agent types - BASED ON USER_LISTS ****** \n      SHOULD BE THE SAME AS ABOVE\n\n";
@@ -649,26 +892,17 @@ static T sum(const vector<T>& vec) {
     return ret;
 }
 
-void tweets_distribution(Network& network) {
+void tweets_distribution(const NetworkSweep& sweep) {
     ofstream tweet_output, retweet_output;
     tweet_output.open("output/tweets_distro.dat");
     retweet_output.open("output/retweets_distro.dat");
 
-    int max_tweets = 0, max_retweets = 0;
-    for (Agent& e : network) {
-        if (e.n_tweets > max_tweets) {
-            max_tweets = e.n_tweets;
-        }
-        if (e.n_retweets > max_retweets) {
-            max_retweets = e.n_retweets;
-        }
-    }
-    vector<int> tweets_distro (max_tweets + 1);
-    vector<int> retweets_distro (max_retweets + 1);
-    for (Agent& e : network) {
-        tweets_distro.at(e.n_tweets) ++;
-        retweets_distro.at(e.n_retweets) ++;
-    }
+    vector<int> tweets_distro = sweep.tweet_counts;
+    vector<int> retweets_distro = sweep.retweet_counts;
+    // At least the 0 bin, as for an empty network:
+    tweets_distro.resize(max<size_t>(tweets_distro.size(), 1), 0);
+    retweets_distro.resize(max<size_t>(retweets_distro.size(), 1), 0);
+    int max_tweets = tweets_distro.size() - 1, max_retweets = retweets_distro.size() - 1;
     int tweets_sum = sum(tweets_distro);
     int retweets_sum = sum(retweets_distro);
     tweet_output << "# n_tweets\tdistro\n\n";
@@ -744,48 +978,24 @@ bool agent_checks(AgentTypeVector& ets, Network& network, AnalysisState& state,
 
 // AGENT_TYPE_INFO.DAT
 
-static void whos_following_who(AgentTypeVector& types, AgentType& type, Network& network) {
+static void whos_following_who(AgentTypeVector& types, AgentType& type, const NetworkSweep::TypeStats& type_stats) {
     string filename = "output/" + type.name + "_info.dat";
     ofstream output;
     output.open(filename.c_str());
-    int max_degree = 0;
-    for (int i = 0; i < type.agents.agent_ids.size(); i ++) {
-        int degree = network.n_followings(type.agents.agent_ids[i]) + network.n_followers(type.agents.agent_ids[i]);
-        if (degree > max_degree) {
-            max_degree = degree;
-        }
-    }
-
-    /* Declare 0-filled counting-vectors. */
-    vector<int> agent_followers(max_degree + 1 /* AD: Needed one past max stored*/, 0);
-    vector<int> agent_following(max_degree + 1, 0);
-    vector<int> agent_degree(max_degree + 1, 0);
-    vector<int> who_following(types.size(), 0);
-    vector<int> who_followers(types.size(), 0);
-
-    double followers_sum = 0, following_sum = 0;
-    for (int i = 0; i < type.agents.agent_ids.size(); i ++) {
-        int id = type.agents.agent_ids[i];
-        int in_degree = network.n_followers(id);
-        int out_degree = network.n_followings(id);
-        agent_followers[in_degree] ++;
-        agent_following[out_degree] ++;
-        agent_degree[in_degree + out_degree] ++;
-
-        // Analyze ins == followers
-        for (int id_fol : network.follower_set(id).as_vector()) {
-            Agent& et = network[id_fol];
-            who_following[et.agent_type] ++;
-            following_sum ++;
-        }
+    int max_degree = max<int>(type_stats.total_degrees.size() - 1, 0);
+
+    /* Copy into counting-vectors, 0-filled up to the highest degree. */
+    vector<int> agent_followers = type_stats.in_degrees;
+    vector<int> agent_following = type_stats.out_degrees;
+    vector<int> agent_degree = type_stats.total_degrees;
+    agent_followers.resize(max_degree + 1 /* AD: Needed one past max stored*/, 0);
+    agent_following.resize(max_degree + 1, 0);
+    agent_degree.resize(max_degree + 1, 0);
+    // Analyze ins == followers, outs == follows:
+    const vector<int>& who_following = type_stats.follower_types;
+    const vector<int>& who_followers = type_stats.followed_types;
+    double following_sum = type_stats.n_followers, followers_sum = type_stats.n_followings;
 
-        // Analyze outs == follows
-        for (int id_fol : network.following_set(id).as_vector()) {
-            Agent& et = network[id_fol];
-            who_followers[et.agent_type] ++;
-            followers_sum ++;
-        }
-    }
     output << "\n# % of Agent_type following Agent_type \'" << type.name << "\'\n# ";
     for (int i = 0; i < types.size(); i ++) {
         output << types[i].name << ": " << who_following[i] / following_sum * 100.0 << "   ";
@@ -811,9 +1021,9 @@ static void whos_following_who(AgentTypeVector& types, AgentType& type, Network&
 // function that will plot degree distributions for every agent, and at the top
 // of the files gives you info about the percentage of each agent they are following
 
-void whos_following_who(AgentTypeVector& types, Network& network) {
+void whos_following_who(AgentTypeVector& types, const NetworkSweep& sweep) {
     for (int i = 0; i < types.size(); i ++ ) {
-        whos_following_who(types, types[i], network);
+        whos_following_who(types, types[i], sweep.types[i]);
     }
 }
 
@@ -948,10 +1158,6 @@ void network_statistics(Network& n, NetworkStats& net_stats, AgentTypeVector& et
 
 // REGION_CONNECTION_DISTRIBUTION_MONTH.DAT
 
-struct holder {
-    vector<int> ids;
-};
-
 static void print_n_agents_in_regions(Network& n, AnalysisState& state) {
     int region_counts[N_BIN_REGIONS] = {0};
     for (int i = 0; i < n.size(); i ++) { 
@@ -964,30 +1170,19 @@ static void print_n_agents_in_regions(Network& n, AnalysisState& state) {
     cout << "\n\n";
 }
 
-bool region_stats(Network& n, AnalysisState& state) {
-    holder region_self[N_BIN_REGIONS];
-    int connections[N_BIN_REGIONS][N_BIN_REGIONS] = {};
+bool region_stats(AnalysisState& state, const NetworkSweep& sweep) {
     ofstream output;
     char out[100];
     sprintf(out, "output/region_connection_matrix_month_%03d.dat", state.n_months());
     output.open(((string) out).c_str());
-    
-    for (int i = 0; i < n.size(); i++) {
-        Agent& e = n[i];
-        int reg = e.region_bin;
-        region_self[reg].ids.push_back(i);
-        vector<int> following = e.following_set.as_vector();
-        for (int j = 0; j < following.size(); j ++) {
-            Agent& followee = n[following[j]];
-            connections[reg][followee.region_bin] ++;
-        }
-        
-    }
+
+    // [N_BIN_REGIONS][N_BIN_REGIONS], flattened:
+    const int* connections = sweep.region_connections.data();
     double follow_counts[N_BIN_REGIONS] = {};
     for (int i = 0; i < state.config.regions.size(); i++) {
         int count = 0;
         for (int j = 0; j < state.config.regions.size(); j++) {
-            count += connections[i][j];
+            count += connections[i * N_BIN_REGIONS + j];
         }
         follow_counts[i] = count;
     }
@@ -1001,7 +1196,7 @@ bool region_stats(Network& n, AnalysisState& state) {
             if (j == 0) {
                 output << "\n" << i;
             }
-            double connections_ratio = (follow_counts[i] == 0 ? 0.0 : connections[i][j] / follow_counts[i]);
+            double connections_ratio = (follow_counts[i] == 0 ? 0.0 : connections[i * N_BIN_REGIONS + j] / follow_counts[i]);
             output << "\t" << 100.0 * connections_ratio << "\%";
             if (j+1 == state.config.regions.size()) {
                 output << "\n";
@@ -1156,20 +1351,10 @@ void dd_by_agent(Network& n, AnalysisState& as, NetworkStats& ns) {
 
 // DD_BY_FOLLOW_MODEL
 
-void dd_by_follow_method(Network& n, AnalysisState& as, NetworkStats& ns) {
-    vector<YearDegreeDistro> follow_models(N_FOLLOW_MODELS);
+void dd_by_follow_method(const NetworkSweep& sweep) {
+    const vector<int>* follow_models = sweep.follow_method_degrees;
+    double n_agents = sweep.n_agents;
 
-    for (Agent& a : n) {
-        for (int i = 0; i < N_FOLLOW_MODELS; i ++) {
-            YearDegreeDistro& model = follow_models[i];
-            int degree = a.following_method_counts[i] + a.follower_method_counts[i];
-            if (model.dd.size() <= degree) {
-                model.dd.resize(degree + 1);
-            }
-            model.dd[degree]++;
-        }
-    }
-    
     ofstream output;
     output.open("output/dd_by_follow_model.dat");
     
@@ -1186,15 +1371,15 @@ void dd_by_follow_method(Network& n, AnalysisState& as, NetworkStats& ns) {
     int i = 0;
     while (true) {
         bool has_data = false;
-        for (YearDegreeDistro& model : follow_models) {
-            if (model.dd.size() > i) {
+        for (int model = 0; model < N_FOLLOW_MODELS; model++) {
+            if (follow_models[model].size() > i) {
                 has_data = true;
             }
         }
         output << i << "\t" << log(i);
-        for (YearDegreeDistro& model : follow_models) {
-            double val = model.dd.size() > i ? model.dd[i] : 0;
-            output << "\t" << val / n.size() << "\t" << log(val / n.size());
+        for (int model = 0; model < N_FOLLOW_MODELS; model++) {
+            double val = follow_models[model].size() > i ? follow_models[model][i] : 0;
+            output << "\t" << val / n_agents << "\t" << log(val / n_agents);
         }
         output << "\n";
         if (!has_data) {
@@ -1205,3 +1390,218 @@ void dd_by_follow_method(Network& n, AnalysisState& as, NetworkStats& ns) {
     
     output.close();
 }
+
+// GRAPH EXPORT
+// The follow graph and the agent attributes as .npy arrays, with a JSON manifest listing them,
+// for analysis outside of #k@. The graph is in CSR form: the agents followed by agent i are
+// targets[offsets[i]:offsets[i+1]].
+
+// One array of an export, as listed in its manifest.
+struct ExportedArray {
+    string name, file, dtype;
+    vector<size_t> shape;
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(NVP(name), NVP(file), NVP(dtype), NVP(shape));
+    }
+};
+
+// Write 'values' to 'folder/name.npy', as an array of dimensions 'shape', and list it in 'arrays'.
+template <typename T>
+static bool export_array(const string& folder, const string& name, const vector<T>& values,
+        const vector<size_t>& shape, vector<ExportedArray>& arrays) {
+    ExportedArray array {name, name + ".npy", npy_descr<T>(), shape};
+    NpyWriter writer;
+    bool ok = writer.open(folder + "/" + array.file, array.dtype, shape);
+    if (ok) {
+        writer.write(values);
+        ok = writer.close();
+    }
+    arrays.push_back(array);
+    return ok;
+}
+
+// 'value(agent, column)' for each agent, 'n_columns' to a row.
+template <typename T, typename Value>
+static vector<T> agent_column(Network& network, int n_columns, Value value) {
+    int n_agents = network.size();
+    vector<T> values((size_t)n_agents * n_columns);
+    for_each_agent_chunk(n_agents, REPORT_CHUNK_SIZE, [&](int chunk, int begin, int end) {
+        for (int id = begin; id < end; id++) {
+            for (int c = 0; c < n_columns; c++) {
+                values[(size_t)id * n_columns + c] = value(network[id], c);
+            }
+        }
+    });
+    return values;
+}
+
+void export_graph(AnalysisState& state, const char* name) {
+    Network& network = state.network;
+    ParsedConfig& C = state.config;
+    int n_agents = network.size();
+    string folder = string("output/") + name;
+    if (mkdir(folder.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("Could not create the folder '%s' for the graph export!\n", folder.c_str());
+        return;
+    }
+    bool ok = true;
+    vector<ExportedArray> arrays;
+
+    // The offsets come from the degrees alone:
+    vector<int64_t> offsets(n_agents + 1, 0);
+    for (int id = 0; id < n_agents; id++) {
+        offsets[id + 1] = offsets[id] + network.n_followings(id);
+    }
+    int64_t n_edges = offsets[n_agents];
+    ok = export_array(folder, "offsets", offsets, {offsets.size()}, arrays) && ok;
+
+    // The targets are gathered a batch of agents at a time, into their place in the batch, and written
+    // out in one piece:
+    ExportedArray targets {"targets", "targets.npy", npy_descr<int32_t>(), {(size_t)n_edges}};
+    NpyWriter writer;
+    ok = writer.open(folder + "/" + targets.file, targets.dtype, targets.shape) && ok;
+    const int BATCH_SIZE = 64 * REPORT_CHUNK_SIZE;
+    vector<int32_t> batch;
+    for (int first = 0; ok && first < n_agents; first += BATCH_SIZE) {
+        int batch_end = min(first + BATCH_SIZE, n_agents);
+        batch.resize(offsets[batch_end] - offsets[first]);
+        for_each_agent_chunk(batch_end - first, REPORT_CHUNK_SIZE, [&](int chunk, int begin, int end) {
+            for (int id = first + begin; id < first + end; id++) {
+                size_t pos = offsets[id] - offsets[first];
+                network.following_set(id).for_each([&](int id_fol) {
+                    batch[pos++] = id_fol;
+                });
+            }
+        });
+        writer.write(batch);
+    }
+    ok = writer.close() && ok;
+    arrays.push_back(targets);
+
+    // The agent attributes, one column each:
+    vector<size_t> column = {(size_t)n_agents};
+    vector<size_t> method_columns = {(size_t)n_agents, (size_t)N_FOLLOW_MODELS};
+    ok = export_array(folder, "agent_type", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.agent_type;}), column, arrays) && ok;
+    ok = export_array(folder, "region_bin", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.region_bin;}), column, arrays) && ok;
+    ok = export_array(folder, "language", agent_column<int32_t>(network, 1, [](Agent& e, int) {return (int)e.language;}), column, arrays) && ok;
+    ok = export_array(folder, "ideology_bin", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.ideology_bin;}), column, arrays) && ok;
+    ok = export_array(folder, "preference_class", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.preference_class;}), column, arrays) && ok;
+    ok = export_array(folder, "n_tweets", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.n_tweets;}), column, arrays) && ok;
+    ok = export_array(folder, "n_retweets", agent_column<int32_t>(network, 1, [](Agent& e, int) {return e.n_retweets;}), column, arrays) && ok;
+    ok = export_array(folder, "creation_time", agent_column<double>(network, 1, [](Agent& e, int) {return e.creation_time;}), column, arrays) && ok;
+    ok = export_array(folder, "following_method_counts", agent_column<int32_t>(network, N_FOLLOW_MODELS,
+            [](Agent& e, int method) {return e.details().following_method_counts[method];}), method_columns, arrays) && ok;
+    ok = export_array(folder, "follower_method_counts", agent_column<int32_t>(network, N_FOLLOW_MODELS,
+            [](Agent& e, int method) {return e.details().follower_method_counts[method];}), method_columns, arrays) && ok;
+
+    // The manifest, with the names behind the bins:
+    vector<string> agent_types, regions, languages, ideologies, preference_classes;
+    for (AgentType& type : state.agent_types) {
+        agent_types.push_back(type.name);
+    }
+    for (Region& region : C.regions.regions) {
+        regions.push_back(region.name);
+    }
+    for (int i = 0; i < N_LANGS; i++) {
+        languages.push_back(language_name(i));
+    }
+    for (Ideology& ideology : C.ideologies) {
+        ideologies.push_back(ideology.name);
+    }
+    for (PreferenceClass& pref_class : C.pref_classes) {
+        preference_classes.push_back(pref_class.name);
+    }
+    vector<string> follow_methods = {"random", "twitter_suggest", "agent", "preferential_agent",
+            "hashtag", "followback", "retweeting"};
+    ofstream manifest((folder + "/manifest.json").c_str());
+    { // Scope off 'ar', which finishes the JSON when destroyed
+        cereal::JSONOutputArchive ar(manifest);
+        string format = "hashkat-graph";
+        int version = 1;
+        ar(NVP(format), NVP(version), cereal::make_nvp("month", state.n_months()),
+           cereal::make_nvp("time", state.time), NVP(n_agents), NVP(n_edges),
+           NVP(agent_types), NVP(regions), NVP(languages), NVP(ideologies),
+           NVP(preference_classes), NVP(follow_methods), NVP(arrays));
+    }
+    manifest << "\n";
+    manifest.close();
+    if (!ok || !manifest) {
+        printf("Could not write the graph export to '%s'!\n", folder.c_str());
+    }
+}
+
+// TEXT WRITER BENCHMARK
+// Writes a synthetic network.dat of 'n_edges' edges (100 per agent) to the output folder, the old way
+// through an ofstream, and through TextWriter with each compression this build has, and reports the
+// edges written per second of each.
+
+int benchmark_text_writers(long long n_edges) {
+    const int EDGES_PER_AGENT = 100;
+    const char* FILE_NAME = "output/benchmark_network.dat";
+    int n_agents = max<long long>(n_edges / EDGES_PER_AGENT, 1);
+    n_edges = (long long)n_agents * EDGES_PER_AGENT;
+    // Spread the followers over the agents, so the ids have realistic widths:
+    auto follower = [&](int id, int i) {
+        return (int)((id * 2654435761ULL + i * 40503ULL) % n_agents);
+    };
+    auto report = [&](const char* name, Timer& timer, const string& file_name) {
+        double seconds = timer.get_microseconds() / 1e6;
+        ifstream written(file_name.c_str(), ios::binary | ios::ate);
+        double megabytes = written.tellg() / (1024.0 * 1024.0);
+        printf("%-36s %8.2f s %14.0f edges/s %10.1f MB\n", name, seconds, n_edges / seconds, megabytes);
+        remove(file_name.c_str());
+    };
+
+    printf("Writing %lld edges of %d agents to '%s':\n", n_edges, n_agents, FILE_NAME);
+    {
+        Timer timer;
+        ofstream output(FILE_NAME);
+        if (!output) {
+            printf("Could not open '%s'! Does the output folder exist?\n", FILE_NAME);
+            return 1;
+        }
+        output << "# Agent ID\tFollower ID\n\n";
+        for (int id = 0; id < n_agents; id++) {
+            for (int i = 0; i < EDGES_PER_AGENT; i++) {
+                output << id << "\t\t" << follower(id, i) << "\n";
+            }
+        }
+        output.close();
+        report("ofstream", timer, FILE_NAME);
+    }
+    {
+        Timer timer;
+        TextWriter output;
+        output.open(FILE_NAME);
+        output << "# Agent ID\tFollower ID\n\n";
+        for (int id = 0; id < n_agents; id++) {
+            for (int i = 0; i < EDGES_PER_AGENT; i++) {
+                output << id << "\t\t" << follower(id, i) << "\n";
+            }
+        }
+        output.close();
+        report("TextWriter", timer, FILE_NAME);
+    }
+    const OutputCompression COMPRESSIONS[] = {COMPRESS_NONE, COMPRESS_GZIP, COMPRESS_ZSTD};
+    const char* NAMES[] = {"TextWriter, parallel formatting", "  + gzip", "  + zstd"};
+    for (int c = 0; c < 3; c++) {
+        if (!TextWriter::supports(COMPRESSIONS[c])) {
+            printf("%-36s (not built in)\n", NAMES[c]);
+            continue;
+        }
+        Timer timer;
+        TextWriter output;
+        output.open(FILE_NAME, COMPRESSIONS[c]);
+        output << "# Agent ID\tFollower ID\n\n";
+        write_per_agent(output, n_agents, [&](int id, TextWriter& out) {
+            for (int i = 0; i < EDGES_PER_AGENT; i++) {
+                out << id << "\t\t" << follower(id, i) << "\n";
+            }
+        });
+        output.close();
+        report(NAMES[c], timer, TextWriter::file_name(FILE_NAME, COMPRESSIONS[c]));
+    }
+    return 0;
+}
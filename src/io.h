@@ -29,29 +29,73 @@
 
 #include "analyzer.h"
 #include "network.h"
+#include "util/StatCalc.h"
 
+// The agent and edge statistics of the reports, gathered in one sweep over the network
+// (see sweep_network). Only the groups asked for are filled in.
+struct NetworkSweep {
+    // The groups to gather:
+    bool degrees = false, agent_types = false, regions = false;
+    bool follow_methods = false, tweets = false, attributes = false;
 
-void output_position(Network& network);
+    int n_agents = 0;
+
+    // 'degrees': histograms by degree, over every agent.
+    std::vector<int> out_degrees, in_degrees, total_degrees;
+
+    // 'agent_types': per agent type, the same histograms, and the agent types on either side of their edges.
+    struct TypeStats {
+        std::vector<int> out_degrees, in_degrees, total_degrees;
+        std::vector<int> follower_types, followed_types;
+        double n_followers = 0, n_followings = 0;
+    };
+    std::vector<TypeStats> types;
+
+    // 'regions': follows from each region to each region, at [from * N_BIN_REGIONS + to].
+    std::vector<int> region_connections;
+
+    // 'follow_methods': histograms by the degree due to each follow method.
+    std::vector<int> follow_method_degrees[N_FOLLOW_MODELS];
+
+    // 'tweets': histograms by tweet and retweet count.
+    std::vector<int> tweet_counts, retweet_counts;
+
+    // 'attributes': agents per bin, and summaries of the per-agent counts.
+    std::vector<int> languages, ideologies, region_bins, preference_classes;
+    StatCalc follower_stats, following_stats, tweet_stats, retweet_stats;
+};
+
+void sweep_network(Network& network, AnalysisState& state, NetworkSweep& sweep);
+
+// Write the follow graph in CSR form and the agent attributes as .npy arrays, with a manifest.json,
+// to the folder output/<name>/ (see 'graph_export' in docs/input.md).
+void export_graph(AnalysisState& state, const char* name);
+
+
+void output_position(Network& network, OutputCompression compression);
 void brief_agent_statistics(AnalysisState& state);
 void output_network_statistics(AnalysisState& state);
+void print_memory_report(AnalysisState& state);
 
 int factorial(int input_number);
 void Categories_Check(CategoryGrouper& tweeting, CategoryGrouper& following, CategoryGrouper& retweeting);
 void agent_statistics(Network& network,int n_follows, int n_agents, int max_agents, AgentType* agenttype);
-void tweets_distribution(Network& network);
+void tweets_distribution(const NetworkSweep& sweep);
 int rand_int(int max);
-void degree_distributions(Network& network, AnalysisState& state);
+void degree_distributions(AnalysisState& state, const NetworkSweep& sweep);
 bool quick_rate_check(AgentTypeVector& ets, double& correct_val, int& i, int& j);
 bool agent_checks(AgentTypeVector& ets, Network& network, AnalysisState& state, Add_Rates& add_rates, int& initial_agents);
-void whos_following_who(AgentTypeVector& ets, Network& network);
+void whos_following_who(AgentTypeVector& ets, const NetworkSweep& sweep);
 void visualize_most_popular_tweet(MostPopularTweet& mpt, Network& network);
 void network_statistics(Network& n, NetworkStats& stats, AgentTypeVector& etv);
-bool region_stats(Network& n, AnalysisState& state);
+bool region_stats(AnalysisState& state, const NetworkSweep& sweep);
 void fraction_of_connections_distro(Network& network, AnalysisState& state, NetworkStats& net_stats);
 void dd_by_age(Network& n, AnalysisState& as, NetworkStats& ns);
 void dd_by_agent(Network& n, AnalysisState& as, NetworkStats& ns);
-void dd_by_follow_method(Network& n, AnalysisState& as, NetworkStats& ns);
+void dd_by_follow_method(const NetworkSweep& sweep);
 void most_popular_tweet_content(MostPopularTweet& mpt, Network& network);
-void tweet_info(std::vector<Tweet>&);
+void tweet_info(std::vector<Tweet>&, OutputCompression compression);
 void n_agents_in_regions(Network& n);
+// hashkat --benchmark-writers [n_edges]: time the text outputs on a synthetic network.dat.
+int benchmark_text_writers(long long n_edges);
 #endif
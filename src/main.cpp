@@ -86,6 +86,9 @@ int main(int argc, char** argv) {
 	if (has_flag(argc, argv, "--tests")) {
 		// running tests:
 		return test_main(argc, argv);
+	} else if (has_flag(argc, argv, "--benchmark-writers")) {
+	    // Time the text outputs on a synthetic network.dat, 100M edges unless given:
+	    return benchmark_text_writers(std::stoll(get_var_arg(argc, argv, "--benchmark-writers", "100000000")));
 	} else {
 	    printf("Starting #k@ network simulator (version %s)\n", HASHKAT_VERSION);
 	    // NOTE: We rely on hashkat_pre.py to create a -generated version of our input file!
@@ -105,12 +108,22 @@ int main(int argc, char** argv) {
                 seed = (int)t;
         }
 
-        printf("Starting simulation with seed '%d'.\n", seed);
         AnalysisState analysis_state(config, seed);
+        if (has_flag(argc, argv, "--compact-checkpoints")) {
+            // Fold the checkpoint deltas of the save file into a new snapshot, without simulating:
+            analyzer_compact_checkpoints(analysis_state, config.save_file.c_str());
+            return 0;
+        }
+
+        printf("Starting simulation with seed '%d'.\n", seed);
 
         analyzer_main(analysis_state);
         output_network_statistics(analysis_state);
 
+        if (has_flag(argc, argv, "--memory-report")) {
+            print_memory_report(analysis_state);
+        }
+
 #ifdef REFACTORING
         std::ofstream out("output/network_refactoring.dat");
         analysis_state.network.print(out);
@@ -36,6 +36,8 @@
 #include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <new>
 
 #include "util.h"
 
@@ -45,9 +47,104 @@
 #include "events.h"
 #include "tweets.h"
 
+// Agents are stored in fixed-size blocks, allocated only once the network grows into them.
+// Agent addresses are therefore stable, and memory follows size() rather than max_size().
+const int AGENT_BLOCK_SIZE = 1024;
+
+// Storage for one object per slot of an agent block. Objects are constructed by the block
+// as agents occupy the slots, so the unoccupied tail of a block is never touched.
+template <typename T>
+class AgentBlockArray {
+    alignas(T) char storage[AGENT_BLOCK_SIZE * sizeof(T)];
+public:
+    T& operator[](int i) {
+        return reinterpret_cast<T*>(storage)[i];
+    }
+    const T& operator[](int i) const {
+        return reinterpret_cast<const T*>(storage)[i];
+    }
+};
+
+// Within a block, agent records, their details and the two follow structures are kept in separate
+// arrays, so that scans over agent records do not drag the rest into cache. An agent's slot is its
+// id modulo the block size, which is how Agent finds the rest of itself (see AgentBlock::of).
+struct AgentBlock {
+    AgentBlockArray<Agent> agents; // Must be the first member, see of()
+    AgentBlockArray<AgentDetails> details;
+    AgentBlockArray<FollowingSet> following_sets;
+    AgentBlockArray<FollowerSet> follower_sets;
+    int n_agents = 0;
+    FollowerLayersFactory follower_layers; // For the follower sets of agents still to be added
+
+    AgentBlock(FollowerLayersFactory follower_layers)
+            : follower_layers(follower_layers) {
+    }
+    AgentBlock(const AgentBlock&) = delete;
+    AgentBlock& operator=(const AgentBlock&) = delete;
+    ~AgentBlock() {
+        for (int i = 0; i < n_agents; i++) {
+            agents[i].~Agent();
+            details[i].~AgentDetails();
+            following_sets[i].~FollowingSet();
+            follower_sets[i].~FollowerSet();
+        }
+    }
+
+    void add_agent(int id) {
+        int i = n_agents++;
+        new (&agents[i]) Agent();
+        new (&details[i]) AgentDetails();
+        new (&following_sets[i]) FollowingSet();
+        new (&follower_sets[i]) FollowerSet();
+        follower_sets[i].set_layers_factory(follower_layers);
+        agents[i].id = id;
+    }
+    void set_follower_layers(FollowerLayersFactory follower_layers) {
+        this->follower_layers = follower_layers;
+        for (int i = 0; i < n_agents; i++) {
+            follower_sets[i].set_layers_factory(follower_layers);
+        }
+    }
+
+    // The block holding 'agent', found by stepping back to the first agent record of the block.
+    static AgentBlock& of(const Agent& agent) {
+        const Agent* first = &agent - agent.id % AGENT_BLOCK_SIZE;
+        return *reinterpret_cast<AgentBlock*>(const_cast<Agent*>(first));
+    }
+};
+
+inline AgentDetails& Agent::details() {
+    return AgentBlock::of(*this).details[id % AGENT_BLOCK_SIZE];
+}
+inline const AgentDetails& Agent::details() const {
+    return AgentBlock::of(*this).details[id % AGENT_BLOCK_SIZE];
+}
+inline FollowingSet& Agent::following_set() {
+    return AgentBlock::of(*this).following_sets[id % AGENT_BLOCK_SIZE];
+}
+inline const FollowingSet& Agent::following_set() const {
+    return AgentBlock::of(*this).following_sets[id % AGENT_BLOCK_SIZE];
+}
+inline FollowerSet& Agent::follower_set() {
+    return AgentBlock::of(*this).follower_sets[id % AGENT_BLOCK_SIZE];
+}
+inline const FollowerSet& Agent::follower_set() const {
+    return AgentBlock::of(*this).follower_sets[id % AGENT_BLOCK_SIZE];
+}
+
 class Network {
-    std::vector<Agent> agents;
+    std::vector< std::unique_ptr<AgentBlock> > blocks;
     int n_agents = 0, max_agents = 0;
+    // The bins in use by agents, which the follower sets are specialized for:
+    FollowerSetDims follower_dims;
+    FollowerLayersFactory follower_layers = follower_layers_factory(FollowerSetDims());
+
+    Agent& slot(int index) const {
+        return blocks[index / AGENT_BLOCK_SIZE]->agents[index % AGENT_BLOCK_SIZE];
+    }
+    int n_allocated() const {
+        return blocks.size() * AGENT_BLOCK_SIZE;
+    }
 public:
     int size() const {
         return n_agents;
@@ -57,22 +154,40 @@ public:
     }
     void grow() {
         DEBUG_CHECK(n_agents < max_agents, "Cannot grow network, at max_agents!");
+        if (n_agents == n_allocated()) {
+            blocks.emplace_back(new AgentBlock(follower_layers));
+        }
+        blocks.back()->add_agent(n_agents);
         ++n_agents;
     }
 
     Agent& operator[](int index) { //** This allows us to index our Network struct as if it were an array.
         DEBUG_CHECK(index >= 0 && index < n_agents, "Network out-of-bounds agent access");
-        return agents[index];
+        return slot(index);
     }
 
+    // Sets the agent cap. Agent blocks are allocated lazily by grow().
     void allocate(int n) {
         max_agents = n;
-        agents = std::vector<Agent>(max_agents);
+        n_agents = 0;
+        blocks.clear();
+        blocks.reserve((max_agents + AGENT_BLOCK_SIZE - 1) / AGENT_BLOCK_SIZE);
+    }
+
+    // Specializes the follower sets for 'dims', see FollowerSet.h.
+    // Must be set while all follower sets are empty.
+    void set_follower_dims(const FollowerSetDims& dims) {
+        follower_dims = dims;
+        follower_layers = follower_layers_factory(dims);
+        for (auto& block : blocks) {
+            block->set_follower_layers(follower_layers);
+        }
     }
 
     // Convenient network queries:
     FollowingSet& following_set(int id) {
-        return agents[id].following_set;
+        DEBUG_CHECK(is_valid_id(id), "Network out-of-bounds agent access");
+        return blocks[id / AGENT_BLOCK_SIZE]->following_sets[id % AGENT_BLOCK_SIZE];
     }
 
     bool is_valid_id(int id) {
@@ -80,7 +195,8 @@ public:
     }
 
     FollowerSet& follower_set(int id) {
-        return agents[id].follower_set;
+        DEBUG_CHECK(is_valid_id(id), "Network out-of-bounds agent access");
+        return blocks[id / AGENT_BLOCK_SIZE]->follower_sets[id % AGENT_BLOCK_SIZE];
     }
 
     // Return last agent:
@@ -95,25 +211,85 @@ public:
         return follower_set(id).size();
     }
 
+    // Approximate bytes held by the agent records and by their follow sets, including
+    // the slots of the last agent block that the network has not grown into yet.
+    void memory_usage(size_t& agent_bytes, size_t& following_bytes, size_t& follower_bytes) const {
+        agent_bytes = sizeof(*this) + blocks.capacity() * sizeof(blocks[0]);
+        following_bytes = 0, follower_bytes = 0;
+        for (int i = 0; i < n_agents; i++) {
+            const Agent& agent = slot(i);
+            agent_bytes += agent.memory_usage();
+            following_bytes += agent.following_set().memory_usage();
+            follower_bytes += agent.follower_set().memory_usage();
+        }
+        // Unoccupied slots are only reserved:
+        size_t n_unused = n_allocated() - n_agents;
+        agent_bytes += n_unused * (sizeof(Agent) + sizeof(AgentDetails));
+        following_bytes += n_unused * sizeof(FollowingSet);
+        follower_bytes += n_unused * sizeof(FollowerSet);
+    }
+
+    size_t memory_usage() const {
+        size_t agent_bytes, following_bytes, follower_bytes;
+        memory_usage(agent_bytes, following_bytes, follower_bytes);
+        return agent_bytes + following_bytes + follower_bytes;
+    }
+
     // To allow for-each style loops:
-    Agent* begin() {
-        return &agents[0];
+    struct iterator {
+        Network* network;
+        int index;
+        Agent& operator*() const {
+            return network->slot(index);
+        }
+        iterator& operator++() {
+            ++index;
+            return *this;
+        }
+        bool operator!=(const iterator& o) const {
+            return index != o.index;
+        }
+    };
+    iterator begin() {
+        return iterator {this, 0};
     }
-    Agent* end() {
-        return begin() + n_agents;
+    iterator end() {
+        return iterator {this, n_agents};
     }
 
+    // Only the agents grown into are stored:
     template <typename Archive>
     void save(Archive& ar) const {
-        ar(n_agents, max_agents, agents);
+        ar(n_agents, max_agents);
+        for (int i = 0; i < n_agents; i++) {
+            ar(slot(i));
+        }
     }
     template <typename Archive>
     void load(Archive& ar) {
-        ar(n_agents, max_agents, agents);
+        int n_stored = 0, max_stored = 0;
+        ar(n_stored, max_stored);
+        allocate(max_stored);
+        for (int i = 0; i < n_stored; i++) {
+            grow();
+            ar(slot(i));
+            ASSERT(slot(i).id == i, "Loaded agent ids must match their order in the network!");
+        }
+        fit_follower_dims();
         for (Agent& agent : *this) {
             agent.post_load(get_state(ar));
         }
     }
+
+    // Loaded agents may come from a differing configuration, widen the follower sets to fit them.
+    // Must be called while all follower sets are empty.
+    void fit_follower_dims() {
+        FollowerSetDims dims = follower_dims;
+        for (Agent& agent : *this) {
+            dims.include(agent);
+        }
+        set_follower_dims(dims);
+    }
 };
 
 #endif  // HASHKAT_NETWORK_H_
@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "tweets.h"
 #include "analyzer.h"
 
@@ -20,18 +22,91 @@ void Tweet::api_serialize(cereal::JSONOutputArchive& ar) {
        NVP(content_type), NVP(language),
        // Twitter API:
        cereal::make_nvp("retweet_count", content->used_agents.size()),
-       cereal::make_nvp("author_follower_count", get_state(ar).network[content->id_original_author].follower_set.size()),
+       cereal::make_nvp("author_follower_count", get_state(ar).network[content->id_original_author].follower_set().size()),
        NVP(content_type)
     );
 }
 
+// The weight of one hashtag use at 'time'. Rebases the decay first if the weight is getting large.
+double HashTags::use_weight(double time) {
+    double exponent = trend_exponent(time);
+    if (exponent > MAX_TREND_EXPONENT) {
+        // Scale every popularity down to the new reference time, keeping their ratios:
+        double scale = exp(-exponent);
+        for (HashtagGroup& group : groups) {
+            for (HashtagTopic& topic : group.topics) {
+                topic.popularity *= scale;
+            }
+        }
+        trend_time_ref = time;
+        rebuild_trend_trees();
+        exponent = 0;
+    }
+    return exp(exponent);
+}
+
+int HashTags::choose_topic(MTwist& rng, int ideology_bin, int region_bin, double time) {
+    int group_id = group_index(ideology_bin, region_bin);
+    if (n_topics == 1) {
+        return group_id;
+    }
+    HashtagGroup& group = groups[group_id];
+    double popular_weight = group.trend_tree.total();
+    double unbiased_weight = use_weight(time) * n_topics;
+    double target = rng.rand_real_not0() * (popular_weight + unbiased_weight);
+    int topic;
+    if (target <= popular_weight) {
+        topic = group.topics[group.trend_tree.find(target)].topic;
+    } else {
+        topic = rng.rand_int(n_topics);
+    }
+    return group_id * n_topics + topic;
+}
+
+void HashTags::add(int topic_id, int author_id, double time) {
+    double weight = use_weight(time);
+    HashtagGroup& group = groups[topic_id / n_topics];
+    int topic = topic_id % n_topics;
+    auto inserted = group.slots.insert({topic, (int)group.topics.size()});
+    if (inserted.second) {
+        // First use of the topic:
+        group.topics.emplace_back();
+        group.topics.back().topic = topic;
+        group.trend_tree.push_back(0);
+    }
+    int slot = inserted.first->second;
+    HashtagTopic& chosen = group.topics[slot];
+    chosen.add_author(author_id);
+    chosen.popularity += weight;
+    group.trend_tree.add(slot, weight);
+}
+
 int HashTags::select_agent(AnalysisState& state, bool region_choice, bool ideology_choice, int default_region, int default_ideology) {
     int region_bin = choose_bin(state.rng, region_choice, default_region, state.config.regions.size());
     int ideology_bin = choose_bin(state.rng, ideology_choice, default_ideology, state.config.ideologies.size());
-    if (!hashtag_groups[ideology_bin][region_bin].circ_buffer.empty()) {
-        int agent_to_follow = hashtag_groups[ideology_bin][region_bin].circ_buffer.pick_random_uniform(state.rng);
-        return agent_to_follow;
+    HashtagGroup& group = groups[group_index(ideology_bin, region_bin)];
+    if (group.topics.empty()) {
+        return -1;
     }
-    return -1;
+    int slot = 0;
+    if (n_topics > 1) {
+        // Prefer trending topics: draw by decayed popularity.
+        double total = group.trend_tree.total();
+        if (total <= 0) {
+            return -1;
+        }
+        slot = group.trend_tree.find(state.rng.rand_real_not0() * total);
+    }
+    return group.topics[slot].pick_author(state.rng);
 }
 
+void HashTags::rebuild_trend_trees() {
+    std::vector<double> weights;
+    for (HashtagGroup& group : groups) {
+        weights.resize(group.topics.size());
+        for (int i = 0; i < group.topics.size(); i++) {
+            weights[i] = group.topics[i].popularity;
+        }
+        group.trend_tree.assign(weights);
+    }
+}
@@ -28,15 +28,16 @@
 #include <vector>
 #include <cstdio>
 #include <memory>
+#include <unordered_map>
 
 #include "mtwist.h"
 
 #include "events.h"
-#include "CircularBuffer.h"
 
 #include "serialization.h"
 
 #include "FollowerSet.h"
+#include "util/FenwickTree.h"
 
 typedef HashedEdgeSet<int> UsedAgents;
 
@@ -50,6 +51,20 @@ struct TweetContent {
     int hashtag_bin = -1;
     int id_original_author = -1; // The agent that created the original content
     UsedAgents used_agents;
+    // The tweet bank references of the active tweets with this content, in no particular order.
+    // Maintained by the tweet bank, not serialized.
+    std::vector<int> active_tweets;
+
+    // Approximate bytes held, including the content object itself.
+    size_t memory_usage() const {
+        return sizeof(*this) - sizeof(used_agents) + used_agents.memory_usage()
+                + active_tweets.capacity() * sizeof(int);
+    }
+
+    // Whether 'id_agent' can no longer react to this content, as the author or having reacted already.
+    bool is_excluded(int id_agent) {
+        return id_agent == id_original_author || used_agents.contains(id_agent);
+    }
 
     template <typename Archive>
     void serialize(Archive& ar) {
@@ -62,6 +77,17 @@ struct TweetContent {
     }
 };
 
+// A number of a tweet's excluded followers in one follower set leaf.
+struct ExcludedCount {
+    int leaf_key;
+    int count;
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(NVP(leaf_key), NVP(count));
+    }
+};
+
 // Represents a tweet, either original, or a rebroadcast.
 struct Tweet {
     int id_tweet = -1; // The tweet number
@@ -92,8 +118,16 @@ struct Tweet {
     // Next time to consider rebinning, always more than creation_time
     double retweet_next_rebin_time = -1;
 
-    /* Rates with which this tweet is retweeted: */
-    FollowerSet::Weights react_weights;
+    /* Total rate with which this tweet is retweeted.
+     * The per-bin weights are only determined once the tweet is picked for a retweet. */
+    double react_weight = 0;
+    /* The tweeter's current followers that are excluded by the content (see TweetContent::is_excluded),
+     * left out of react_weight. Counted per follower set leaf, listing only the leaves that have any. */
+    std::vector<ExcludedCount> excluded;
+    int n_excluded = 0; // Total over 'excluded'
+
+    // Positions in the tweet bank's indices of active tweets, see TweetBank. Not serialized.
+    int content_slot = -1, tweeter_slot = -1;
 
     explicit Tweet(const std::shared_ptr<TweetContent>& content = {}) {
         this->content = content;
@@ -107,13 +141,39 @@ struct Tweet {
     // Note: Must be called directly, unlike 'serialize' which is implicitly called when serializing subobjects.
     void api_serialize(cereal::JSONOutputArchive& ar); 
 
+    // Adds 'delta' followers in the leaf 'leaf_key' (see FollowerSet::leaf_key) to the excluded counts.
+    void add_excluded(int leaf_key, int delta) {
+        n_excluded += delta;
+        for (int i = 0; i < excluded.size(); i++) {
+            if (excluded[i].leaf_key == leaf_key) {
+                excluded[i].count += delta;
+                DEBUG_CHECK(excluded[i].count >= 0, "Negative excluded count!");
+                if (excluded[i].count == 0) {
+                    excluded[i] = excluded.back();
+                    excluded.pop_back();
+                }
+                return;
+            }
+        }
+        DEBUG_CHECK(delta > 0, "Negative excluded count!");
+        excluded.push_back(ExcludedCount {leaf_key, delta});
+    }
+
+    // This tweet's share of the bytes held by its content. Content is shared between
+    // a tweet and its retweets, so summing over all holders counts it exactly once.
+    size_t content_memory_usage() const {
+        if (!content) {
+            return 0;
+        }
+        return content->memory_usage() / content.use_count();
+    }
+
     template <typename Archive>
     void serialize(Archive& ar) {
         ar(NVP(id_tweet), NVP(id_tweeter), NVP(id_link), NVP(generation));
         ar(NVP(content));
         ar(NVP(creation_time), NVP(deletion_time), NVP(retweet_time_bin), NVP(hashtag), NVP(retweet_next_rebin_time));
-        // NOTE: Relies on FollowerSet::Weights being a 'plain' (pointer-free) object!
-        ar(NVP(react_weights));
+        ar(NVP(react_weight), NVP(excluded), NVP(n_excluded));
     }
 };
 
@@ -132,37 +192,144 @@ struct MostPopularTweet {
     }
 };
 
+// A single hashtag: the most recent agents to have tweeted it, and its
+// time-decayed popularity (relative to HashTags::trend_time_ref).
+struct HashtagTopic {
+    static const int MAX_RECENT_AUTHORS = 100;
+
+    int topic = -1; // Within its group, see HashTags
+
+    // Ring of recent authors, grown on demand up to MAX_RECENT_AUTHORS.
+    // Once full, 'next' is both the slot to overwrite and the oldest entry.
+    std::vector<int> recent_authors;
+    int next = 0;
+    double popularity = 0;
+
+    bool empty() const {
+        return recent_authors.empty();
+    }
+
+    void add_author(int id) {
+        if (recent_authors.size() < MAX_RECENT_AUTHORS) {
+            recent_authors.push_back(id);
+        } else {
+            recent_authors[next] = id;
+            next = (next + 1) % MAX_RECENT_AUTHORS;
+        }
+    }
+
+    // Uniform over the recent authors, in O(1). Index 'k' counts from the oldest author.
+    int pick_author(MTwist& rng) const {
+        int n = recent_authors.size();
+        int k = rng.rand_int(n);
+        return recent_authors[(n < MAX_RECENT_AUTHORS) ? k : (next + k) % n];
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(NVP(topic), NVP(recent_authors), NVP(next), NVP(popularity));
+    }
+};
+
+// The topics of one (ideology, region) group that have been used, in order of first use.
 struct HashtagGroup {
-    // circular buffer with 100 elements
-    CircularBuffer<int, 100> circ_buffer;
+    std::vector<HashtagTopic> topics;
+    std::unordered_map<int, int> slots; // Topic -> index into 'topics'
+    FenwickTree trend_tree; // Over the topics' popularity, in the same order
+
     template <typename Archive>
     void serialize(Archive& ar) {
-        ar(NVP(circ_buffer));
+        ar(NVP(topics));
     }
 };
 
+/* Hashtag topics, grouped by (ideology, region) of their authors. Each group
+ * has 'n_topics' topics; topic ids are global, 'group * n_topics + topic'.
+ * A topic is only stored once it is first used.
+ *
+ * Every hashtag use adds exp((time - trend_time_ref) / tau) to the topic's
+ * popularity, so older uses decay with the configured half-life relative to
+ * newer ones without ever touching idle topics. A Fenwick tree per group over
+ * these popularities lets hashtag tweets and follows pick trending topics in
+ * O(log n_topics). */
 struct HashTags {
-    // this is the set of bins for idealogies and regions
-    HashtagGroup hashtag_groups[N_BIN_IDEOLOGIES][N_BIN_REGIONS];
+    int n_topics = 1;
+    double trend_halflife = 0; // <= 0 disables decay
+
+    void configure(int n_topics, double trend_halflife) {
+        ASSERT(n_topics >= 1, "Need at least one hashtag topic per group!");
+        this->trend_halflife = trend_halflife;
+        if (n_topics != this->n_topics || groups.empty()) {
+            this->n_topics = n_topics;
+            groups.clear();
+            groups.resize(N_BIN_GROUPS);
+        }
+    }
 
     int choose_bin(MTwist& rng, bool choice, int default_bin, const int n_choices) {
         if (!choice) {
-            return rng.rand_int((int) n_choices);
+            return rng.rand_int(n_choices);
         }
         return default_bin;
     }
 
+    // Pick the topic for a new hashtag tweet at 'time' by an author in the given bins.
+    // Each topic is weighted by its popularity, plus the weight of one use at 'time',
+    // so that unused topics can still be picked.
+    int choose_topic(MTwist& rng, int ideology_bin, int region_bin, double time);
+
+    void add(int topic_id, int author_id, double time);
+
     int select_agent(AnalysisState& state, bool region_choice, bool ideology_choice, int default_region, int default_ideology); 
 
+    size_t memory_usage() const {
+        size_t usage = sizeof(*this) + groups.capacity() * sizeof(HashtagGroup);
+        for (const HashtagGroup& group : groups) {
+            usage += group.topics.capacity() * sizeof(HashtagTopic)
+                    + group.slots.bucket_count() * sizeof(void*)
+                    + group.slots.size() * (sizeof(std::pair<int, int>) + sizeof(void*))
+                    + group.trend_tree.memory_usage() - sizeof(group.trend_tree);
+            for (const HashtagTopic& topic : group.topics) {
+                usage += topic.recent_authors.capacity() * sizeof(int);
+            }
+        }
+        return usage;
+    }
+
     template <typename Archive>
     void serialize(Archive& ar) {
-        for (auto& outer : hashtag_groups) {
-            for (auto& groups : outer) {
-                // Note: works because HashtagGroup contains no pointers internally:
-                ar(groups);
+        ar(NVP(n_topics), NVP(trend_halflife), NVP(trend_time_ref), NVP(groups));
+        // Rebuilt from the topics:
+        for (HashtagGroup& group : groups) {
+            group.slots.clear();
+            for (int i = 0; i < group.topics.size(); i++) {
+                group.slots[group.topics[i].topic] = i;
             }
         }
+        rebuild_trend_trees();
     }
+
+private:
+    static const int N_BIN_GROUPS = N_BIN_IDEOLOGIES * N_BIN_REGIONS;
+    // Rebase the decay once weights reach e^MAX_TREND_EXPONENT, well short of overflow.
+    static constexpr double MAX_TREND_EXPONENT = 64.0;
+
+    std::vector<HashtagGroup> groups;
+    double trend_time_ref = 0;
+
+    static int group_index(int ideology_bin, int region_bin) {
+        return ideology_bin * N_BIN_REGIONS + region_bin;
+    }
+
+    double trend_exponent(double time) const {
+        if (trend_halflife <= 0) {
+            return 0;
+        }
+        return (time - trend_time_ref) * M_LN2 / trend_halflife;
+    }
+
+    double use_weight(double time);
+    void rebuild_trend_trees();
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include <vector>
 #include <map>
+#include <algorithm>
 #include "tests.h"
 
 #include "dependencies/mtwist.h"
@@ -8,6 +9,7 @@
 #include "serialization.h"
 #include "agent.h"
 #include "analyzer.h"
+#include "util/SnapshotFile.h"
 
 using namespace std;
 
@@ -41,8 +43,8 @@ SUITE(serialization) {
         CHECK(test.n_tweets == read.n_tweets);
         CHECK(test.n_retweets == read.n_retweets);
 
-        CHECK(read.follower_set.size() == test.follower_set.size());
-        CHECK(read.following_set.size() == read.following_set.size());
+        CHECK(read.follower_set().size() == test.follower_set().size());
+        CHECK(read.following_set().size() == read.following_set().size());
     }
 
     TEST(network) {
@@ -67,10 +69,14 @@ SUITE(serialization) {
         }
 
         Agent& test = state.network[0];
-        test.follower_set.add(state.network[1]);
-        test.following_set.add(state, 2);
+        test.follower_set().add(state.network[1]);
+        test.following_set().add(state, 2);
 
-        Agent read;
+        // Agents only exist within a network, which owns their follow sets:
+        Network read_network;
+        read_network.allocate(1);
+        read_network.grow();
+        Agent& read = read_network[0];
 
         const char* file_name = "output/test_serialize_agent.json";
         {
@@ -87,10 +93,10 @@ SUITE(serialization) {
 
         check_eq(test, read);
 
-        for (int id_fol : test.follower_set.as_vector()) {
+        for (int id_fol : test.follower_set().as_vector()) {
             CHECK(id_fol == 1);
         }
-        for (int id_fol : test.following_set.as_vector()) {
+        for (int id_fol : test.following_set().as_vector()) {
             CHECK(id_fol == 2);
         }
 
@@ -111,5 +117,126 @@ SUITE(serialization) {
             }
         }
     }
+
+    TEST(snapshot_file) {
+        const char* file_name = "output/test_serialize_snapshot.snap";
+        std::vector<int> ints {1, -2, 3};
+        std::vector<double> doubles {0.5};
+        {
+            SnapshotWriter writer;
+            CHECK(writer.open(file_name, "TEST", 7));
+            writer.write_section(3, ints);
+            writer.write_section(1, std::string("abc"));
+            writer.write_section(2, doubles);
+            CHECK(writer.close());
+        }
+        SnapshotReader reader;
+        CHECK(!reader.open(file_name, "TEST", 8)); // Wrong version
+        CHECK(reader.open(file_name, "TEST", 7));
+        size_t count;
+        const int* read_ints = reader.section<int>(3, count);
+        CHECK(read_ints != NULL && count == 3 && read_ints[1] == -2);
+        const double* read_doubles = reader.section<double>(2, count);
+        CHECK(read_doubles != NULL && count == 1 && read_doubles[0] == 0.5);
+        CHECK((size_t)read_doubles % SNAPSHOT_ALIGN == 0);
+        const char* text = reader.section<char>(1, count);
+        CHECK(text != NULL && std::string(text, count) == "abc");
+        CHECK(reader.section<double>(3, count) == NULL); // Wrong element type
+        CHECK(reader.section<int>(4, count) == NULL); // Missing
+    }
+
+    static void test_agent(AnalysisState& state, int id) {
+        state.network.grow();
+        Agent& e = state.network[id];
+        e.id = id;
+        e.creation_time = id;
+        e.agent_type = 0;
+        e.language = LANG_FRENCH;
+        e.region_bin = 0;
+        e.ideology_bin = 0;
+        e.preference_class = 0;
+    }
+
+    static void test_follow(AnalysisState& state, int follower, int followed) {
+        state.network[follower].following_set().add(state, followed);
+        state.network[followed].follower_set().add(state.network[follower]);
+        state.checkpoints.log_edge(follower, followed, CheckpointLog::FOLLOW);
+    }
+
+    static std::vector<int> sorted(std::vector<int> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    TEST(checkpoint_replay) {
+        ParsedConfig config = parse_yaml_configuration("INFILE.yaml-generated");
+        config.checkpoint_interval = 1;
+        AnalysisState state(config, /*seed*/ 1);
+        const char* file_name = "output/test_serialize_checkpoint.snap";
+        int N_GENERATED = 4;
+        state.network.allocate(N_GENERATED);
+        for (int i = 0; i < N_GENERATED - 1; i++) {
+            test_agent(state, i);
+        }
+        test_follow(state, 0, 1);
+        test_follow(state, 1, 2);
+        analyzer_checkpoint(state, file_name); // The base
+        CHECK(state.checkpoints.enabled && state.checkpoints.n_deltas == 0);
+
+        // A new agent, and changed records:
+        test_agent(state, 3);
+        state.checkpoints.mark_agent(3);
+        state.network[2].n_tweets = 5;
+        state.checkpoints.mark_agent(2);
+        test_follow(state, 3, 0);
+        state.time = 10;
+        analyzer_checkpoint(state, file_name);
+
+        // Only follows, in both directions:
+        state.network[0].following_set().remove(state, 1);
+        state.network[1].follower_set().remove(state.network[0]);
+        state.checkpoints.log_edge(0, 1, CheckpointLog::UNFOLLOW);
+        test_follow(state, 2, 3);
+        analyzer_checkpoint(state, file_name);
+        CHECK(state.checkpoints.n_deltas == 2 && state.checkpoints.edge_changes.empty());
+
+        AnalysisState read_state(config, /*seed*/ 1);
+        analyzer_load_snapshot(read_state, file_name);
+        CHECK(read_state.time == 10);
+        CHECK(read_state.network.size() == state.network.size());
+        for (int i = 0; i < state.network.size(); i++) {
+            check_eq(state.network[i], read_state.network[i]);
+            CHECK(sorted(read_state.network[i].following_set().as_vector()) == sorted(state.network[i].following_set().as_vector()));
+            CHECK(sorted(read_state.network[i].follower_set().as_vector()) == sorted(state.network[i].follower_set().as_vector()));
+        }
+    }
+
+    // A network reloaded under the config it was saved with continues exactly as saved; only a changed
+    // config runs the resubmission pass, whose language draws show up in the random number stream.
+    TEST(reload_config_check) {
+        ParsedConfig config = parse_yaml_configuration("INFILE.yaml-generated");
+        config.max_sim_time = 0;
+        config.save_file = "output/test_serialize_reload.dat";
+        config.save_network_on_timeout = true;
+        config.load_network_on_startup = false;
+        config.checkpoint_interval = 0;
+        AnalysisState saved(config, /*seed*/ 1);
+        analyzer_main(saved);
+        unsigned int next_draw = saved.rng.genrand_int32();
+
+        config.save_network_on_timeout = false;
+        config.load_network_on_startup = true;
+        AnalysisState same(config, /*seed*/ 2);
+        analyzer_main(same);
+        CHECK(same.network.size() == saved.network.size());
+        CHECK(same.rng.genrand_int32() == next_draw);
+
+        config.entire_config_file += "\n# changed";
+        config.ignore_load_config_check = true;
+        AnalysisState changed(config, /*seed*/ 2);
+        analyzer_main(changed);
+        CHECK(changed.network.size() == saved.network.size());
+        CHECK(changed.rng.genrand_int32() != next_draw);
+    }
 }
 
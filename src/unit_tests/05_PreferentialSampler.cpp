@@ -0,0 +1,58 @@
+#include <vector>
+
+#include "tests.h"
+
+#include "PreferentialSampler.h"
+#include "dependencies/mtwist.h"
+
+using namespace std;
+
+SUITE(PreferentialSampler) {
+
+    TEST(basics) {
+        const int N_AGENTS = 1000;
+        PreferentialSampler sampler;
+        vector<int> degrees(N_AGENTS);
+        for (int i = 0; i < N_AGENTS; i++) {
+            degrees[i] = i % 7;
+            sampler.add_agent(degrees[i]);
+        }
+        // Move degrees around after construction:
+        for (int i = 0; i < N_AGENTS; i += 3) {
+            degrees[i] = i % 11;
+            sampler.set_degree(i, degrees[i]);
+        }
+        double expected_total = 0;
+        for (int d : degrees) {
+            expected_total += d + 1;
+        }
+        CHECK_CLOSE(expected_total, sampler.total_weight(), 1e-6);
+
+        // Every agent's cumulative weight range should map back to that agent:
+        double cumulative = 0;
+        for (int i = 0; i < N_AGENTS; i++) {
+            double mid = cumulative + (degrees[i] + 1) / 2.0;
+            CHECK_EQUAL(i, sampler.pick(mid / expected_total));
+            cumulative += degrees[i] + 1;
+        }
+        CHECK_EQUAL(N_AGENTS - 1, sampler.pick(1.0));
+    }
+
+    TEST(exponent) {
+        MTwist rng;
+        rng.init_genrand(1);
+        PreferentialSampler sampler;
+        sampler.set_exponent(2.0);
+        sampler.add_agent(0); // weight 1
+        sampler.add_agent(2); // weight 9
+        int n_second = 0;
+        const int N_DRAWS = 100000;
+        for (int i = 0; i < N_DRAWS; i++) {
+            if (sampler.pick(rng.rand_real_not0()) == 1) {
+                n_second++;
+            }
+        }
+        CHECK_CLOSE(0.9, n_second / (double)N_DRAWS, 0.01);
+    }
+
+}
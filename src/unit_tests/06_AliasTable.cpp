@@ -0,0 +1,36 @@
+#include <vector>
+
+#include "tests.h"
+
+#include "util/AliasTable.h"
+
+using namespace std;
+
+SUITE(AliasTable) {
+
+    TEST(distribution) {
+        MTwist rng;
+        rng.init_genrand(1);
+        vector<double> weights = {0.1, 0.0, 0.6, 0.3};
+        AliasTable table(weights);
+        CHECK_EQUAL(4, table.size());
+
+        const int N_DRAWS = 200000;
+        vector<int> counts(weights.size(), 0);
+        for (int i = 0; i < N_DRAWS; i++) {
+            counts[table.pick(rng)]++;
+        }
+        // Zero-weight entries are never picked:
+        CHECK_EQUAL(0, counts[1]);
+        for (int i = 0; i < weights.size(); i++) {
+            CHECK_CLOSE(weights[i], counts[i] / (double)N_DRAWS, 0.01);
+        }
+    }
+
+    TEST(empty) {
+        vector<double> weights = {0.0, 0.0};
+        AliasTable table(weights);
+        CHECK(table.empty());
+    }
+
+}
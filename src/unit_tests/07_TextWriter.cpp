@@ -0,0 +1,32 @@
+#include <climits>
+#include <sstream>
+#include <iomanip>
+
+#include "tests.h"
+
+#include "util/TextWriter.h"
+
+using namespace std;
+
+SUITE(TextWriter) {
+
+    // The text must read the same as what an ostream writes at its defaults:
+    TEST(matches_ostream) {
+        TextWriter writer;
+        ostringstream expected;
+        const long long INTEGERS[] = {0, 7, -7, 10, 99, 100, 12345, -100000, INT_MAX, INT_MIN, LLONG_MAX, LLONG_MIN};
+        for (long long value : INTEGERS) {
+            writer << value << '\t';
+            expected << value << '\t';
+        }
+        const double DOUBLES[] = {0.0, 1.0, -2.5, 1.0 / 3.0, 1e-7, 123456789.0, 1e300};
+        for (double value : DOUBLES) {
+            writer << value << " ";
+            expected << value << " ";
+        }
+        writer << TextWriter::pad(8) << 42 << TextWriter::pad(2) << "long text" << (unsigned int)3 << "\n";
+        expected << setw(8) << 42 << setw(2) << "long text" << (unsigned int)3 << "\n";
+        CHECK(expected.str() == writer.take_text());
+    }
+
+}
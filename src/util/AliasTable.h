@@ -0,0 +1,108 @@
+#ifndef ALIASTABLE_H_
+#define ALIASTABLE_H_
+
+#include <vector>
+
+#include "dependencies/mtwist.h"
+#include "util.h"
+
+/*
+ * Walker/Vose alias table: O(n) construction from a set of (unnormalized)
+ * weights, then O(1) categorical draws using a single random number.
+ *
+ * Intended for distributions that are fixed once the configuration is
+ * parsed. Zero-weight entries are never picked; if no weight is positive,
+ * the table is left empty.
+ */
+struct AliasTable {
+    AliasTable() {
+    }
+    AliasTable(const double* weights, int n) {
+        build(weights, n);
+    }
+    AliasTable(const std::vector<double>& weights) {
+        build(weights);
+    }
+
+    void build(const std::vector<double>& weights) {
+        build(weights.empty() ? NULL : &weights[0], weights.size());
+    }
+
+    void build(const double* weights, int n) {
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+            total += weights[i];
+        }
+        if (!(total > 0)) {
+            prob.clear(), alias.clear();
+            return;
+        }
+        prob.assign(n, 0.0);
+        alias.assign(n, 0);
+
+        // Scale so that the average bucket holds exactly 1:
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; i++) {
+            scaled[i] = weights[i] * n / total;
+            if (scaled[i] < 1.0) {
+                small.push_back(i);
+            } else {
+                large.push_back(i);
+            }
+        }
+        // Pair each under-full bucket with an over-full one, which donates the remainder:
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(), l = large.back();
+            small.pop_back();
+            prob[s] = scaled[s];
+            alias[s] = l;
+            scaled[l] -= (1.0 - scaled[s]);
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Whatever remains is full, up to rounding:
+        for (int i : large) {
+            prob[i] = 1.0, alias[i] = i;
+        }
+        for (int i : small) {
+            // Only reachable through rounding; never let a zero-weight entry stand alone.
+            prob[i] = (weights[i] > 0) ? 1.0 : 0.0;
+            alias[i] = (weights[i] > 0) ? i : first_positive(weights, n);
+        }
+    }
+
+    int size() const {
+        return prob.size();
+    }
+    bool empty() const {
+        return prob.empty();
+    }
+
+    int pick(MTwist& rng) const {
+        DEBUG_CHECK(!prob.empty(), "Picking from an empty alias table!");
+        double u = rng.rand_real_not1() * prob.size();
+        int i = (int)u;
+        if (UNLIKELY(i == prob.size())) {
+            i--; // Rounding
+        }
+        return (u - i < prob[i]) ? i : alias[i];
+    }
+
+private:
+    std::vector<double> prob;
+    std::vector<int> alias;
+
+    static int first_positive(const double* weights, int n) {
+        for (int i = 0; i < n; i++) {
+            if (weights[i] > 0) {
+                return i;
+            }
+        }
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef FENWICKTREE_H_
+#define FENWICKTREE_H_
+
+#include <vector>
+#include <algorithm>
+
+/*
+ * Fenwick (binary indexed) tree of non-negative weights, for weighted
+ * sampling under updates. Appending a weight, changing a weight, prefix sums
+ * and finding the element a cumulative weight falls in are all O(log n).
+ *
+ * Owners that apply many incremental updates should periodically rebuild
+ * from their exact weights with assign(), to bound floating-point drift.
+ */
+struct FenwickTree {
+    int size() const {
+        return (int)tree.size() - 1;
+    }
+
+    void clear() {
+        tree.assign(1, 0.0);
+    }
+
+    // O(n) construction: each node passes its partial sum up to its parent.
+    void assign(const double* weights, int n) {
+        tree.assign(n + 1, 0.0);
+        for (int i = 1; i <= n; i++) {
+            tree[i] += weights[i - 1];
+            int parent = i + (i & -i);
+            if (parent <= n) {
+                tree[parent] += tree[i];
+            }
+        }
+    }
+    void assign(const std::vector<double>& weights) {
+        assign(weights.empty() ? NULL : &weights[0], weights.size());
+    }
+
+    void push_back(double weight) {
+        // Node 'i' covers the range (i - lowbit(i), i]:
+        int i = tree.size();
+        tree.push_back(weight + prefix_sum(i - 1) - prefix_sum(i - (i & -i)));
+    }
+
+    void add(int index, double delta) {
+        for (int i = index + 1; i < tree.size(); i += (i & -i)) {
+            tree[i] += delta;
+        }
+    }
+
+    // Sum of the first 'n' weights.
+    double prefix_sum(int n) const {
+        double sum = 0;
+        for (int i = n; i > 0; i -= (i & -i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    double total() const {
+        return prefix_sum(size());
+    }
+
+    // The first element whose cumulative weight reaches 'target', for 0 < target <= total().
+    // Rounding may carry the search past the end, in which case the last element is returned.
+    int find(double target) const {
+        int n = size(), pos = 0, step = 1;
+        while (step * 2 <= n) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (pos + step <= n && tree[pos + step] < target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return std::min(pos, n - 1);
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + tree.capacity() * sizeof(double);
+    }
+
+private:
+    std::vector<double> tree = std::vector<double>(1, 0.0); // 1-indexed
+};
+
+#endif
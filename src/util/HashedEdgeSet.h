@@ -8,6 +8,7 @@
 #include "serialization.h"
 
 #include "CerealArchiveFileMock.h"
+#include "PoolAllocator.h"
 #include <google/sparse_hash_set>
 
 // Trivial hash, for google sparse hash:
@@ -17,6 +18,17 @@ struct Hasher {
     }
 };
 
+// Allocator for the sparse hash groups. By default, groups come from size-classed
+// pools (see PoolAllocator.h); build with BUILD_FLAGS=-DNO_EDGE_SET_POOL to use
+// sparse hash's default malloc/realloc allocator instead.
+#ifdef NO_EDGE_SET_POOL
+template <typename T>
+using EdgeSetAllocator = google::libc_allocator_with_realloc<T>;
+#else
+template <typename T>
+using EdgeSetAllocator = pool_allocator<T>;
+#endif
+
 /*
  * Wrapper class for using google sparse hash to hold our graph.
  * Most importantly, using our modified sparse hash impl., we reach
@@ -25,7 +37,7 @@ struct Hasher {
  *
  * T must be a pointer, or integer.
  */
-template<typename T, typename HasherT = Hasher>
+template<typename T, typename HasherT = Hasher, typename AllocT = EdgeSetAllocator<T> >
 struct HashedEdgeSet {
     HashedEdgeSet() {
         hash_impl.set_deleted_key((T) -1);
@@ -109,6 +121,15 @@ struct HashedEdgeSet {
 		hash_impl.insert(elem);
 		return (hash_impl.size() > prev_size);
     }
+    // Insert 'n' elements, sizing the table for all of them first. Returns the number that were new.
+    size_t insert_all(const T* elems, size_t n) {
+        reserve(size() + n);
+        size_t n_added = 0;
+        for (size_t i = 0; i < n; i++) {
+            n_added += insert(elems[i]);
+        }
+        return n_added;
+    }
 
     bool empty() const {
         return hash_impl.empty();
@@ -116,11 +137,29 @@ struct HashedEdgeSet {
     size_t size() const {
         return hash_impl.size();
     }
+    // Size the table for 'n' elements up front, avoiding rehashes while filling it.
+    void reserve(size_t n) {
+        hash_impl.resize(n);
+    }
     void clear() {
         hash_impl = HashSet();
         hash_impl.set_deleted_key((T) -1);
     }
 
+    // Number of hash slots, occupied or not.
+    size_t bucket_count() const {
+        return hash_impl.bucket_count();
+    }
+
+    // Approximate bytes held by the set, including the set object itself.
+    // The sparsetable keeps one group header per DEFAULT_SPARSEGROUP_SIZE hash slots,
+    // and each group packs its occupied slots densely.
+    size_t memory_usage() const {
+        typedef google::sparsegroup<T, google::DEFAULT_SPARSEGROUP_SIZE, typename HashSet::allocator_type> Group;
+        size_t n_groups = (bucket_count() + google::DEFAULT_SPARSEGROUP_SIZE - 1) / google::DEFAULT_SPARSEGROUP_SIZE;
+        return sizeof(*this) + n_groups * sizeof(Group) + size() * sizeof(T);
+    }
+
     std::vector<T> as_vector() {
         std::vector<T> ret;
 
@@ -137,6 +176,7 @@ struct HashedEdgeSet {
         clear();
         size_t size = 0;
         ar( cereal::make_size_tag(size) );
+        reserve(size);
         for (int i = 0; i < size; i++) {
             T elem;
             ar(elem);
@@ -145,7 +185,7 @@ struct HashedEdgeSet {
     }
     template <typename Archive>
     void save(Archive& ar) const {
-        auto vec = ((HashedEdgeSet<T>*)this)->as_vector();
+        auto vec = ((HashedEdgeSet*)this)->as_vector();
         ar( cereal::make_size_tag( (size_t) vec.size() ) );
         for (T& elem : vec) {
             ASSERT(elem != -1, "Woops");
@@ -153,7 +193,7 @@ struct HashedEdgeSet {
         }
     }
 private:
-    typedef google::sparse_hash_set<T, HasherT> HashSet;
+    typedef google::sparse_hash_set<T, HasherT, std::equal_to<T>, AllocT> HashSet;
     HashSet hash_impl; // If NULL, empty
 };
 
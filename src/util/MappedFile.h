@@ -0,0 +1,76 @@
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Read-only memory mapping of a whole file. Pages are read in by the OS as
+ * they are touched, so large inputs can be streamed through without copying
+ * them into our own buffers first.
+ */
+struct MappedFile {
+    MappedFile() {
+    }
+    ~MappedFile() {
+        close();
+    }
+
+    // Returns false if the file could not be opened or mapped. An empty file maps to no data.
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        bool ok = (fstat(fd, &info) == 0);
+        if (ok && info.st_size > 0) {
+            void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = (mapped != MAP_FAILED);
+            if (ok) {
+                bytes = (const char*)mapped;
+                length = info.st_size;
+                // Inputs are read front to back:
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    void close() {
+        if (bytes != NULL) {
+            munmap((void*)bytes, length);
+        }
+        bytes = NULL, length = 0;
+    }
+
+    // View the file as an array of T; any trailing partial element is ignored.
+    template <typename T>
+    const T* data() const {
+        return (const T*)bytes;
+    }
+    template <typename T>
+    size_t count() const {
+        return length / sizeof(T);
+    }
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* bytes = NULL;
+    size_t length = 0;
+
+    // Non-copyable, the mapping is owned:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef NPYFILE_H_
+#define NPYFILE_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Writer for numpy's .npy format (version 1.0): a short text header giving the
+ * element type and shape, then the raw array. The header is padded so the data
+ * starts 64-byte aligned, and numpy.load(path, mmap_mode='r') can map the file
+ * in place. Elements are written in the host's byte order, which the header
+ * records ('<' for little-endian, as on x86 and ARM).
+ */
+
+// The numpy type string of T, eg "<i4" for int32_t on a little-endian host.
+template <typename T>
+inline std::string npy_descr() {
+    const uint16_t ONE = 1;
+    std::string descr = (*(const char*)&ONE == 1) ? "<" : ">";
+    if (sizeof(T) == 1) {
+        descr[0] = '|'; // Single bytes have no order
+    }
+    descr += (T(0.5) != 0) ? 'f' : (T(-1) < T(0) ? 'i' : 'u');
+    descr += std::to_string(sizeof(T));
+    return descr;
+}
+
+struct NpyWriter {
+    static const size_t NPY_ALIGN = 64;
+
+    NpyWriter() {
+    }
+    ~NpyWriter() {
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    // Opens 'path' for an array of 'descr' elements with dimensions 'shape', in C order.
+    bool open(const std::string& path, const std::string& descr, const std::vector<size_t>& shape) {
+        file = fopen(path.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        // The arrays are written in large pieces already:
+        setvbuf(file, NULL, _IONBF, 0);
+        std::string dims;
+        for (size_t dim : shape) {
+            dims += std::to_string(dim) + ", ";
+        }
+        if (shape.size() > 1) {
+            dims.resize(dims.size() - 2); // Only a 1-tuple keeps its trailing comma
+        }
+        std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + dims + "), }";
+        // Magic, version and header length take 10 bytes; pad with spaces to the alignment, ending in a newline:
+        size_t header_size = 10 + dict.size() + 1;
+        dict.append((NPY_ALIGN - header_size % NPY_ALIGN) % NPY_ALIGN, ' ');
+        dict += '\n';
+        uint16_t dict_size = dict.size();
+        const char prefix[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+        write(prefix, sizeof(prefix));
+        const unsigned char length[2] = {(unsigned char)(dict_size & 0xFF), (unsigned char)(dict_size >> 8)};
+        write(length, sizeof(length));
+        write(dict.data(), dict.size());
+        return ok;
+    }
+
+    void write(const void* data, size_t bytes) {
+        if (bytes > 0) {
+            ok = ok && fwrite(data, 1, bytes, file) == bytes;
+        }
+    }
+
+    template <typename T>
+    void write(const std::vector<T>& values) {
+        write(values.data(), values.size() * sizeof(T));
+    }
+
+    // Returns false if any write failed.
+    bool close() {
+        if (file == NULL) {
+            return false;
+        }
+        ok = (fclose(file) == 0) && ok;
+        file = NULL;
+        return ok;
+    }
+
+private:
+    FILE* file = NULL;
+    bool ok = true;
+
+    // Non-copyable, the file is owned:
+    NpyWriter(const NpyWriter&);
+    NpyWriter& operator=(const NpyWriter&);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef PARALLELFOR_H_
+#define PARALLELFOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <pthread.h>
+
+/*
+ * Process-wide pool of worker threads, started on first use and kept for
+ * the life of the process. Workers outlive each parallel_for call, so their
+ * thread-local state (eg, the edge set pools of PoolAllocator.h) is reused
+ * from one parallel phase to the next, rather than lost on thread exit.
+ */
+class ThreadPool {
+public:
+    // Never destroyed: workers idle until the process exits, which may happen from a worker (eg, error_exit).
+    static ThreadPool& instance() {
+        static ThreadPool* pool = new ThreadPool();
+        return *pool;
+    }
+
+    // Number of threads available to a parallel_for, including its caller.
+    int n_threads() const {
+        return forked ? 1 : (int)workers.size() + 1;
+    }
+
+    // Number of workers waiting for a job, a snapshot that may be out of date at once.
+    int n_idle() const {
+        return n_waiting;
+    }
+
+    // How many parallel_for tasks the calling thread is running, ie, whether a parallel_for is nested.
+    static int& task_depth() {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    void submit(const std::function<void()>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        wakeup.notify_one();
+    }
+
+private:
+    ThreadPool() {
+        int n_workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for (int i = 0; i < n_workers; i++) {
+            workers.emplace_back([this]() {
+                work();
+            });
+        }
+        // A forked child (see analyzer_snapshot.cpp) has none of the workers, it runs everything itself:
+        pthread_atfork(NULL, NULL, []() {
+            instance().forked = true;
+        });
+    }
+
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                n_waiting++;
+                wakeup.wait(lock, [this]() {
+                    return !jobs.empty();
+                });
+                n_waiting--;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<int> n_waiting {0};
+    bool forked = false;
+};
+
+/*
+ * Run 'task(i)' for every i in [0, n_tasks), spread over the thread pool.
+ * Tasks are handed out one at a time, so results must depend only on the
+ * task index (never on which thread ran it) to stay deterministic.
+ *
+ * The caller works through the tasks too, and only waits on the workers
+ * that actually joined in. A call therefore never blocks on a busy pool,
+ * and calls may nest: a call made from within a task (eg, a report's
+ * agent loop, see io.cpp) only asks for the workers that are idle, and
+ * never adds threads of its own.
+ */
+template <typename Func>
+inline void parallel_for(int n_tasks, Func task) {
+    ThreadPool& pool = ThreadPool::instance();
+    int n_threads = std::min(pool.n_threads(), n_tasks);
+    if (ThreadPool::task_depth() > 0) {
+        n_threads = std::min(n_threads, pool.n_idle() + 1);
+    }
+    if (n_threads <= 1) {
+        for (int i = 0; i < n_tasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    // Shared with helpers that may only start once the call has returned:
+    struct Shared {
+        std::atomic<int> next {0};
+        std::atomic<int> n_active {0};
+        std::function<void(int)> task;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    int n = n_tasks;
+    shared->task = [&task](int i) {
+        task(i);
+    };
+
+    for (int t = 1; t < n_threads; t++) {
+        pool.submit([shared, n]() {
+            // Joining in is announced before claiming a task, so the caller waits for every claimed task:
+            shared->n_active++;
+            ThreadPool::task_depth()++;
+            for (int i = shared->next++; i < n; i = shared->next++) {
+                shared->task(i);
+            }
+            ThreadPool::task_depth()--;
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (--shared->n_active == 0) {
+                shared->done.notify_all();
+            }
+        });
+    }
+    ThreadPool::task_depth()++;
+    for (int i = shared->next++; i < n; i = shared->next++) {
+        task(i);
+    }
+    ThreadPool::task_depth()--;
+    // Every task is claimed; wait for those running elsewhere. Helpers starting later find nothing to do.
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [&]() {
+        return shared->n_active == 0;
+    });
+}
+
+#endif
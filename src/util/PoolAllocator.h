@@ -0,0 +1,152 @@
+#ifndef POOLALLOCATOR_H_
+#define POOLALLOCATOR_H_
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+/*
+ * Size-classed pool allocator for the many small, frequently resized
+ * allocations made by google sparse hash (one group array per 48 hash slots,
+ * reallocated on every insert/erase into the group).
+ *
+ * Requests up to MAX_POOLED_BYTES are rounded up to a multiple of
+ * POOL_GRANULARITY and served from a per-size-class free list, refilled
+ * from large arena chunks. Larger requests go to malloc. Freed blocks are
+ * kept on their free list for reuse and are never returned to the system.
+ *
+ * Pools are thread-local; a block freed on another thread simply joins
+ * that thread's free list. The memory held is bounded all the same: a
+ * thread only carves a new chunk once its free list for the size class is
+ * empty, so its chunks never exceed the most bytes it has had handed out
+ * and not yet freed on it at once, plus less than one chunk per size class
+ * (N_SIZE_CLASSES * CHUNK_BYTES = 2MB per thread). Parallel phases run on
+ * the persistent workers of ParallelFor.h, so no pool is stranded by its
+ * thread exiting.
+ */
+struct EdgeSetPool {
+    static const size_t POOL_GRANULARITY = 8;
+    static const size_t MAX_POOLED_BYTES = 256;
+    static const size_t N_SIZE_CLASSES = MAX_POOLED_BYTES / POOL_GRANULARITY;
+    static const size_t CHUNK_BYTES = 64 * 1024;
+
+    static void* allocate(size_t bytes) {
+        if (bytes > MAX_POOLED_BYTES) {
+            return malloc(bytes);
+        }
+        size_t cls = size_class(bytes);
+        FreeBlock*& head = instance().free_lists[cls];
+        if (head == NULL) {
+            instance().refill(cls);
+        }
+        FreeBlock* block = head;
+        head = block->next;
+        return block;
+    }
+
+    static void deallocate(void* ptr, size_t bytes) {
+        if (ptr == NULL) {
+            return;
+        }
+        if (bytes > MAX_POOLED_BYTES) {
+            free(ptr);
+            return;
+        }
+        FreeBlock*& head = instance().free_lists[size_class(bytes)];
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next = head;
+        head = block;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    FreeBlock* free_lists[N_SIZE_CLASSES] = {NULL};
+
+    static EdgeSetPool& instance() {
+        static thread_local EdgeSetPool pool;
+        return pool;
+    }
+
+    // Size classes are 8, 16, ..., MAX_POOLED_BYTES bytes (zero-byte requests use the smallest).
+    static size_t size_class(size_t bytes) {
+        return bytes == 0 ? 0 : (bytes - 1) / POOL_GRANULARITY;
+    }
+
+    // Carve a fresh arena chunk into blocks of the given size class.
+    void refill(size_t cls) {
+        size_t block_bytes = (cls + 1) * POOL_GRANULARITY;
+        size_t n_blocks = CHUNK_BYTES / block_bytes;
+        char* chunk = (char*)malloc(n_blocks * block_bytes);
+        if (chunk == NULL) {
+            throw std::bad_alloc();
+        }
+        for (size_t i = 0; i < n_blocks; i++) {
+            FreeBlock* block = (FreeBlock*)(chunk + i * block_bytes);
+            block->next = free_lists[cls];
+            free_lists[cls] = block;
+        }
+    }
+};
+
+// STL-style allocator adaptor over EdgeSetPool, for use with google sparse hash.
+template<class T>
+class pool_allocator {
+public:
+    typedef T value_type;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    pool_allocator() {}
+    template <class U>
+    pool_allocator(const pool_allocator<U>&) {}
+
+    pointer address(reference r) const {
+        return &r;
+    }
+    const_pointer address(const_reference r) const {
+        return &r;
+    }
+
+    pointer allocate(size_type n, const void* = 0) {
+        return static_cast<pointer>(EdgeSetPool::allocate(n * sizeof(value_type)));
+    }
+    void deallocate(pointer p, size_type n) {
+        EdgeSetPool::deallocate(p, n * sizeof(value_type));
+    }
+
+    size_type max_size() const {
+        return static_cast<size_type>(-1) / sizeof(value_type);
+    }
+
+    void construct(pointer p, const value_type& val) {
+        new(p) value_type(val);
+    }
+    void destroy(pointer p) {
+        p->~value_type();
+    }
+
+    template<class U>
+    struct rebind {
+        typedef pool_allocator<U> other;
+    };
+};
+
+template<class T, class U>
+inline bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return true;
+}
+
+template<class T, class U>
+inline bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef SNAPSHOTFILE_H_
+#define SNAPSHOTFILE_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <streambuf>
+
+#include "MappedFile.h"
+
+/*
+ * A versioned file of typed sections. Each section is a flat array, aligned
+ * to SNAPSHOT_ALIGN bytes, so that a reader can map the file and use the
+ * arrays in place. The section table is written last, and the header is
+ * patched to point at it once all sections are out.
+ *
+ * Layout: [header][section 0][section 1]...[section table]
+ */
+
+const uint32_t SNAPSHOT_ALIGN = 64;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_sections;
+    uint64_t table_offset;
+};
+
+struct SnapshotSection {
+    uint32_t id;
+    uint32_t element_size;
+    uint64_t offset; // From the start of the file
+    uint64_t size; // In bytes
+};
+
+struct SnapshotWriter {
+    SnapshotWriter() {
+    }
+    ~SnapshotWriter() {
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    bool open(const std::string& path, const char* magic, uint32_t version) {
+        file = fopen(path.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        // Sections are written in large pieces, do not split them up further:
+        setvbuf(file, NULL, _IOFBF, 1 << 20);
+        memset(&header, 0, sizeof(header));
+        strncpy(header.magic, magic, sizeof(header.magic));
+        header.version = version;
+        return write_raw(&header, sizeof(header));
+    }
+
+    void begin_section(uint32_t id, uint32_t element_size) {
+        pad_to_alignment();
+        SnapshotSection section = {id, element_size, position, 0};
+        sections.push_back(section);
+    }
+
+    void write(const void* data, size_t bytes) {
+        write_raw(data, bytes);
+        sections.back().size += bytes;
+    }
+
+    template <typename T>
+    void write_section(uint32_t id, const std::vector<T>& values) {
+        begin_section(id, sizeof(T));
+        write(values.data(), values.size() * sizeof(T));
+    }
+
+    void write_section(uint32_t id, const std::string& bytes) {
+        begin_section(id, 1);
+        write(bytes.data(), bytes.size());
+    }
+
+    // Writes the section table and header. Returns false if any write failed.
+    bool close() {
+        pad_to_alignment();
+        header.n_sections = sections.size();
+        header.table_offset = position;
+        write_raw(sections.data(), sections.size() * sizeof(SnapshotSection));
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = (fclose(file) == 0) && ok;
+        file = NULL;
+        return ok;
+    }
+
+private:
+    FILE* file = NULL;
+    SnapshotHeader header;
+    std::vector<SnapshotSection> sections;
+    uint64_t position = 0;
+    bool ok = true;
+
+    bool write_raw(const void* data, size_t bytes) {
+        if (bytes > 0) {
+            ok = ok && fwrite(data, 1, bytes, file) == bytes;
+        }
+        position += bytes;
+        return ok;
+    }
+
+    void pad_to_alignment() {
+        static const char zeros[SNAPSHOT_ALIGN] = {0};
+        write_raw(zeros, (SNAPSHOT_ALIGN - position % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN);
+    }
+
+    // Non-copyable, the file is owned:
+    SnapshotWriter(const SnapshotWriter&);
+    SnapshotWriter& operator=(const SnapshotWriter&);
+};
+
+struct SnapshotReader {
+    // Returns false if the file could not be mapped, or is not a snapshot of 'version' with a sane section table.
+    bool open(const std::string& path, const char* magic, uint32_t version) {
+        if (!mapped.open(path) || mapped.size() < sizeof(SnapshotHeader)) {
+            return false;
+        }
+        const SnapshotHeader& header = *mapped.data<SnapshotHeader>();
+        if (strncmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != version) {
+            return false;
+        }
+        uint64_t table_end = header.table_offset + (uint64_t)header.n_sections * sizeof(SnapshotSection);
+        if (header.table_offset % SNAPSHOT_ALIGN != 0 || table_end > mapped.size()) {
+            return false;
+        }
+        table = (const SnapshotSection*)(mapped.data<char>() + header.table_offset);
+        n_sections = header.n_sections;
+        for (int i = 0; i < n_sections; i++) {
+            if (table[i].offset % SNAPSHOT_ALIGN != 0 || table[i].offset + table[i].size > header.table_offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The section 'id' viewed as an array of T, in place. Returns NULL if it is missing or holds another type.
+    template <typename T>
+    const T* section(uint32_t id, size_t& count) const {
+        for (int i = 0; i < n_sections; i++) {
+            if (table[i].id == id && table[i].element_size == sizeof(T)) {
+                count = table[i].size / sizeof(T);
+                return (const T*)(mapped.data<char>() + table[i].offset);
+            }
+        }
+        count = 0;
+        return NULL;
+    }
+
+private:
+    MappedFile mapped;
+    const SnapshotSection* table = NULL;
+    int n_sections = 0;
+};
+
+// Presents mapped bytes as a stream, for archives that read through std::istream.
+struct SnapshotStreamBuf : public std::streambuf {
+    SnapshotStreamBuf(const char* bytes, size_t size) {
+        char* begin = (char*)bytes;
+        setg(begin, begin, begin + size);
+    }
+};
+
+#endif
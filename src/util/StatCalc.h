@@ -35,6 +35,26 @@ struct StatCalc {
         average = new_average;
     }
 
+    // Combine with the statistics of another set of elements, as if they had all been added here.
+    // Uses the pairwise update of Chan et al. for the Q-value.
+    void merge(const StatCalc& other) {
+        if (other.n_elements == 0) {
+            return;
+        }
+        if (n_elements == 0) {
+            *this = other;
+            return;
+        }
+        double n_total = n_elements + other.n_elements;
+        double delta = other.average - average;
+        q_value += other.q_value + delta * delta * n_elements * other.n_elements / n_total;
+        sum += other.sum;
+        max = std::max(max, other.max);
+        min = std::min(min, other.min);
+        n_elements = n_total;
+        average = sum / n_elements;
+    }
+
     double standard_deviation() {
         if (n_elements == 0) {
             return 0;
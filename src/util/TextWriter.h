@@ -0,0 +1,291 @@
+#ifndef TEXTWRITER_H_
+#define TEXTWRITER_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef HASHKAT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HASHKAT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Buffered writer for the large text outputs (network.dat, tweet_info.dat, ...).
+ * Values are formatted straight into one large buffer, which is handed to the
+ * file, or to a gzip or zstd stream, whenever it fills up. Integers are formatted
+ * by hand, two digits at a time. Doubles are formatted as printf's %g, which is the
+ * text an ostream gives at its default precision, so files read the same as when
+ * they were written through an ofstream.
+ *
+ * Without a file open, the text is only kept in the buffer (see take_text()), so that
+ * parts of a file can be formatted on several threads and written in order.
+ */
+
+enum OutputCompression {
+    COMPRESS_NONE,
+    COMPRESS_GZIP,
+    COMPRESS_ZSTD
+};
+
+struct TextWriter {
+    // Width to right-align the next value to, like std::setw:
+    struct Pad {
+        int width;
+    };
+    static Pad pad(int width) {
+        return Pad {width};
+    }
+
+    TextWriter() {
+    }
+    ~TextWriter() {
+        close();
+    }
+
+    // Whether this build can write 'compression'.
+    static bool supports(OutputCompression compression) {
+#ifndef HASHKAT_HAVE_ZLIB
+        if (compression == COMPRESS_GZIP) {
+            return false;
+        }
+#endif
+#ifndef HASHKAT_HAVE_ZSTD
+        if (compression == COMPRESS_ZSTD) {
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // The name 'path' is written under, with the extension of 'compression'.
+    static std::string file_name(const std::string& path, OutputCompression compression) {
+        if (compression == COMPRESS_GZIP) {
+            return path + ".gz";
+        } else if (compression == COMPRESS_ZSTD) {
+            return path + ".zst";
+        }
+        return path;
+    }
+
+    // Opens file_name(path, compression). Returns false if it could not be opened, or if
+    // this build cannot write 'compression'.
+    bool open(const std::string& path, OutputCompression compression = COMPRESS_NONE) {
+        close();
+        ok = supports(compression);
+        std::string name = file_name(path, compression);
+        if (ok && compression == COMPRESS_NONE) {
+            file = fopen(name.c_str(), "wb");
+            // The buffer here is large already:
+            ok = (file != NULL) && setvbuf(file, NULL, _IONBF, 0) == 0;
+        }
+#ifdef HASHKAT_HAVE_ZLIB
+        if (ok && compression == COMPRESS_GZIP) {
+            // A fast level, the files are compressed on the fly:
+            gz = gzopen(name.c_str(), "wb1");
+            ok = (gz != NULL) && gzbuffer(gz, BUFFER_SIZE) == 0;
+        }
+#endif
+#ifdef HASHKAT_HAVE_ZSTD
+        if (ok && compression == COMPRESS_ZSTD) {
+            file = fopen(name.c_str(), "wb");
+            zstd = ZSTD_createCCtx();
+            ok = (file != NULL) && (zstd != NULL);
+            compressed.resize(ZSTD_CStreamOutSize());
+        }
+#endif
+        buffer.reserve(BUFFER_SIZE + MAX_FIELD_SIZE);
+        return ok;
+    }
+
+    // Writes out what is buffered and closes the file. Returns false if any write failed.
+    bool close() {
+        flush(/*end*/ true);
+        if (file != NULL) {
+            ok = (fclose(file) == 0) && ok;
+            file = NULL;
+        }
+#ifdef HASHKAT_HAVE_ZLIB
+        if (gz != NULL) {
+            ok = (gzclose(gz) == Z_OK) && ok;
+            gz = NULL;
+        }
+#endif
+#ifdef HASHKAT_HAVE_ZSTD
+        if (zstd != NULL) {
+            ZSTD_freeCCtx(zstd);
+            zstd = NULL;
+        }
+#endif
+        return ok;
+    }
+
+    // Hands over the text formatted so far, when no file is open.
+    std::string take_text() {
+        std::string text;
+        text.swap(buffer);
+        return text;
+    }
+
+    TextWriter& operator<<(const Pad& p) {
+        width = p.width;
+        return *this;
+    }
+
+    TextWriter& operator<<(const char* str) {
+        return put(str, strlen(str));
+    }
+    TextWriter& operator<<(const std::string& str) {
+        return put(str.data(), str.size());
+    }
+    TextWriter& operator<<(char c) {
+        return put(&c, 1);
+    }
+    TextWriter& operator<<(bool value) {
+        return put(value ? "1" : "0", 1);
+    }
+
+    TextWriter& operator<<(int value) {
+        return put_signed(value);
+    }
+    TextWriter& operator<<(long value) {
+        return put_signed(value);
+    }
+    TextWriter& operator<<(long long value) {
+        return put_signed(value);
+    }
+    TextWriter& operator<<(unsigned int value) {
+        return put_unsigned(value);
+    }
+    TextWriter& operator<<(unsigned long value) {
+        return put_unsigned(value);
+    }
+    TextWriter& operator<<(unsigned long long value) {
+        return put_unsigned(value);
+    }
+
+    TextWriter& operator<<(double value) {
+        char digits[MAX_FIELD_SIZE];
+        int length = snprintf(digits, sizeof(digits), "%g", value);
+        return put(digits, length);
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const int MAX_FIELD_SIZE = 64;
+
+    std::string buffer;
+    int width = 0;
+    bool ok = true;
+    FILE* file = NULL;
+#ifdef HASHKAT_HAVE_ZLIB
+    gzFile gz = NULL;
+#endif
+#ifdef HASHKAT_HAVE_ZSTD
+    ZSTD_CCtx* zstd = NULL;
+    std::string compressed;
+#endif
+
+    bool has_sink() const {
+        bool has_sink = (file != NULL);
+#ifdef HASHKAT_HAVE_ZLIB
+        has_sink = has_sink || (gz != NULL);
+#endif
+        return has_sink;
+    }
+
+    TextWriter& put(const char* str, size_t length) {
+        if (width > (int)length) {
+            buffer.append(width - length, ' ');
+        }
+        width = 0;
+        buffer.append(str, length);
+        if (buffer.size() >= BUFFER_SIZE && has_sink()) {
+            flush(/*end*/ false);
+        }
+        return *this;
+    }
+
+    template <typename T>
+    TextWriter& put_signed(T value) {
+        char digits[MAX_FIELD_SIZE];
+        char* end = digits + sizeof(digits);
+        // Negated as unsigned, which is exact for the smallest value too:
+        unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+        char* begin = format_digits(end, magnitude);
+        if (value < 0) {
+            *--begin = '-';
+        }
+        return put(begin, end - begin);
+    }
+
+    template <typename T>
+    TextWriter& put_unsigned(T value) {
+        char digits[MAX_FIELD_SIZE];
+        char* end = digits + sizeof(digits);
+        char* begin = format_digits(end, value);
+        return put(begin, end - begin);
+    }
+
+    // Writes the digits of 'value' backwards, ending at 'end'. Returns where they start.
+    static char* format_digits(char* end, unsigned long long value) {
+        static const char PAIRS[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+        char* pos = end;
+        while (value >= 100) {
+            int pair = (value % 100) * 2;
+            value /= 100;
+            *--pos = PAIRS[pair + 1];
+            *--pos = PAIRS[pair];
+        }
+        if (value >= 10) {
+            *--pos = PAIRS[value * 2 + 1];
+            *--pos = PAIRS[value * 2];
+        } else {
+            *--pos = '0' + value;
+        }
+        return pos;
+    }
+
+    void flush(bool end) {
+        if (!has_sink()) {
+            return;
+        }
+#ifdef HASHKAT_HAVE_ZSTD
+        if (zstd != NULL) {
+            ZSTD_inBuffer in = {buffer.data(), buffer.size(), 0};
+            bool done = false;
+            while (ok && !done) {
+                ZSTD_outBuffer out = {&compressed[0], compressed.size(), 0};
+                size_t remaining = ZSTD_compressStream2(zstd, &out, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+                ok = !ZSTD_isError(remaining) && fwrite(out.dst, 1, out.pos, file) == out.pos;
+                done = end ? (remaining == 0) : (in.pos == in.size);
+            }
+            buffer.clear();
+            return;
+        }
+#endif
+        if (!buffer.empty()) {
+            if (file != NULL) {
+                ok = ok && fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+            }
+#ifdef HASHKAT_HAVE_ZLIB
+            if (gz != NULL) {
+                ok = ok && gzwrite(gz, buffer.data(), buffer.size()) == (int)buffer.size();
+            }
+#endif
+        }
+        buffer.clear();
+    }
+
+    // Non-copyable, the file is owned:
+    TextWriter(const TextWriter&);
+    TextWriter& operator=(const TextWriter&);
+};
+
+#endif